@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "alloc_stats.hpp"
+
+#include <atomic>
+
+/**
+ *  \brief  Counters of the threads sharing a slot, on a cache line of their own.
+ */
+struct alignas(64) AllocationCounters
+{
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> bytes{0};
+};
+
+/// Number of counter slots. Threads beyond it share slots, which costs contention but no counts.
+constexpr size_t NUM_COUNTER_SLOTS = 64;
+
+/// Counters are spread over slots so that the workers of parallel_for_ do not contend for one cache
+/// line on every allocation. The slots outlive the threads, so no counts are lost at thread exit.
+static AllocationCounters g_counters[NUM_COUNTER_SLOTS];
+static std::atomic<size_t> g_nextSlot{0};
+
+AllocationStats GetAllocationStats()
+{
+    AllocationStats stats;
+    for (const auto& counters : g_counters)
+    {
+        stats.count += counters.count.load(std::memory_order_relaxed);
+        stats.bytes += counters.bytes.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+#if defined(__GLIBC__)
+
+#include <cerrno>
+
+extern "C"
+{
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+static void CountAllocation(const size_t size)
+{
+    // A trivially initialized thread_local needs no allocation, so it is safe inside malloc.
+    static thread_local AllocationCounters* counters = nullptr;
+    if (!counters)
+    {
+        counters = &g_counters[g_nextSlot.fetch_add(1, std::memory_order_relaxed) % NUM_COUNTER_SLOTS];
+    }
+    counters->count.fetch_add(1, std::memory_order_relaxed);
+    counters->bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void* malloc(size_t size)
+{
+    CountAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    CountAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    CountAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    CountAllocation(size);
+    void* result = __libc_memalign(alignment, size);
+    if (!result)
+    {
+        return ENOMEM;
+    }
+    *ptr = result;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+}
+
+#endif
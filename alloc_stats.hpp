@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ *  \brief  Number of heap allocations and allocated bytes.
+ */
+struct AllocationStats
+{
+    /// Number of allocations.
+    size_t count = 0;
+    /// Number of requested bytes.
+    size_t bytes = 0;
+};
+
+/**
+ *  \brief  Returns the number of heap allocations since the start of the process.
+ *
+ *  Allocations are counted by interposing the malloc family of the C library, so they include the
+ *  buffers of cv::Mat and of other libraries. Counting is supported with glibc only; elsewhere the
+ *  returned counters stay zero. The interposer is linked into every binary that uses qurcore; it
+ *  adds two uncontended atomic increments on a per-thread counter slot to each allocation.
+ */
+AllocationStats GetAllocationStats();
@@ -0,0 +1,502 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+
+#include "alloc_stats.hpp"
+#include "corpus.hpp"
+#include "qr_capacity.hpp"
+#include "qr_encoder.hpp"
+#include "qur.hpp"
+
+/**
+ *  \brief  Holds command line arguments.
+ */
+struct CommandLineArguments
+{
+    /// Run only benchmarks whose name contains this string.
+    std::string filter;
+    /// Minimum measured time of a benchmark in seconds.
+    double minTime = 0.2;
+    /// Compare the in-tree QR encoder with libqrencode instead of running benchmarks.
+    bool checkQrEncoder = false;
+};
+
+/**
+ *  \brief  Parses command line arguments.
+ *  \param  argc    Number of command line arguments.
+ *  \param  argv    Array of command line strings.
+ *  \returns    Parsed command line arguments.
+ */
+static CommandLineArguments ParseCommandLineArguments(const int argc, char** argv)
+{
+    CommandLineArguments result;
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string(argv[i]);
+        if (arg == "--filter")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.filter = argv[++i];
+        }
+        else if (arg == "--min-time")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.minTime = stod(std::string(argv[++i]));
+        }
+        else if (arg == "--check")
+        {
+            result.checkQrEncoder = true;
+        }
+        else if (arg == "-h")
+        {
+            std::cerr << "Usage: ./qurtest_bench [OPTION]..." << std::endl;
+            std::cerr << "\t-h\tPrint help and exist." << std::endl;
+            std::cerr << "\t--filter <value>\tRun only benchmarks whose name contains the value." << std::endl;
+            std::cerr << "\t--min-time <value>\tMinimum measured time of a benchmark in seconds (default=0.2)." << std::endl;
+            std::cerr << "\t--check\tCompare the in-tree QR encoder bit for bit with libqrencode in all versions, levels and modes, generate a corpus of short messages and exit." << std::endl;
+            exit(0);
+        }
+        else
+        {
+            assert(false && "Unexpected command line argument");
+        }
+    }
+    return result;
+}
+
+/**
+ *  \brief  Prevents the compiler from optimizing away a computed value.
+ */
+template <typename T>
+static void Consume(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ *  \brief  Returns a random string of UR characters.
+ */
+static std::string MakeUrLikeString(const size_t len, cv::RNG& rng)
+{
+    static const std::string CHARSET = "abcdefghijklmnopqrstuvwxyz0123456789:/-";
+    std::string result(len, ' ');
+    for (auto& c : result)
+    {
+        c = CHARSET[rng.uniform(0, static_cast<int>(CHARSET.size()))];
+    }
+    return result;
+}
+
+/**
+ *  \brief  Encodes a payload as a single segment of the given mode in the smallest version.
+ *
+ *  libqrencode's string splitter may add segments whose headers overflow a full Micro QR code,
+ *  so the segment is built explicitly. Micro QR inputs need a fixed version, so they are tried
+ *  from M1 up.
+ *
+ *  \returns    QR code, or null if the payload does not fit.
+ */
+static QrCodePtr EncodeSingleSegment(const std::string& payload, const QRencodeMode mode, const bool isMicro)
+{
+    for (int version = isMicro ? 1 : 0; version <= (isMicro ? QR_MICRO_MAX_VERSION : 0); ++version)
+    {
+        std::unique_ptr<QRinput, decltype(&QRinput_free)> input(isMicro ? QRinput_newMQR(version, QR_ECLEVEL_L) : QRinput_new2(0, QR_ECLEVEL_L), &QRinput_free);
+        if (input && QRinput_append(input.get(), mode, static_cast<int>(payload.size()), reinterpret_cast<const unsigned char*>(payload.data())) == 0)
+        {
+            QrCodePtr qur(QRcode_encodeInput(input.get()));
+            if (qur)
+            {
+                return qur;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/**
+ *  \brief  Compares the in-tree QR encoder with libqrencode.
+ *
+ *  Every version, EC level and mode is encoded with the shortest and the longest string of that
+ *  version. Symbols are compared with the mask chosen by each encoder and, to tell mask selection
+ *  from encoding errors, with the mask libqrencode chose.
+ *
+ *  \returns    Number of mismatches.
+ */
+static int CheckQrEncoder()
+{
+    cv::RNG rng(1);
+    QrEncoder encoder;
+    int numMismatches = 0;
+    int numChecks = 0;
+    for (const auto mode : {QrEncodingMode::Byte, QrEncodingMode::Alphanumeric})
+    {
+        for (int level = QR_ECLEVEL_L; level <= QR_ECLEVEL_H; ++level)
+        {
+            QrOptions options;
+            options.mode = mode;
+            options.ecLevel = static_cast<QRecLevel>(level);
+            for (int version = QR_MIN_VERSION; version <= QR_MAX_VERSION; ++version)
+            {
+                const int capacity = GetQrCapacity(version, options.ecLevel, GetQrencodeMode(mode));
+                const int previousCapacity = version == QR_MIN_VERSION ? 0 : GetQrCapacity(version - 1, options.ecLevel, GetQrencodeMode(mode));
+                for (const int len : {previousCapacity + 1, capacity})
+                {
+                    const auto ur = MakeUrLikeString(len, rng);
+                    const auto expected = EncodeQr(ur, options);
+                    const auto area = static_cast<size_t>(expected->width) * expected->width;
+                    const auto isEqual = [&](const QRcode& actual)
+                    {
+                        if (actual.version != expected->version || actual.width != expected->width)
+                        {
+                            return false;
+                        }
+                        for (size_t i = 0; i < area; ++i)
+                        {
+                            if ((actual.data[i] & 1) != (expected->data[i] & 1))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+
+                    const bool isSymbolEqual = isEqual(encoder.Encode(ur, options));
+                    const bool isEncodingEqual = isEqual(encoder.Encode(ur, options, GetQrMask(expected.get())));
+                    ++numChecks;
+                    if (!isSymbolEqual || !isEncodingEqual)
+                    {
+                        ++numMismatches;
+                        std::cerr << "Mismatch: mode " << (mode == QrEncodingMode::Byte ? "byte" : "alnum") << ", level " << "LMQH"[level]
+                            << ", version " << version << ", length " << len
+                            << (isEncodingEqual ? ", mask selection differs" : ", encoding differs") << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    std::cerr << numChecks - numMismatches << " of " << numChecks << " symbols identical" << std::endl;
+
+    // The vector Reed-Solomon kernels must agree with the scalar one in every block layout.
+    int numKernelMismatches = 0;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> actual;
+    for (int level = QR_ECLEVEL_L; level <= QR_ECLEVEL_H; ++level)
+    {
+        for (int version = QR_MIN_VERSION; version <= QR_MAX_VERSION; ++version)
+        {
+            const auto layout = GetQrBlockLayout(version, static_cast<QRecLevel>(level));
+            data.resize(GetQrDataCodewords(version, static_cast<QRecLevel>(level)));
+            std::generate(data.begin(), data.end(), [&rng]{ return static_cast<uint8_t>(rng.uniform(0, 256)); });
+            expected.resize((layout.numShortBlocks + layout.numLongBlocks) * layout.eccLength);
+            actual.resize(expected.size());
+            EncodeRsBlocks(data.data(), layout, expected.data(), RsKernel::Scalar);
+            for (const auto kernel : {RsKernel::Ssse3, RsKernel::Avx2})
+            {
+                if (IsRsKernelSupported(kernel))
+                {
+                    EncodeRsBlocks(data.data(), layout, actual.data(), kernel);
+                    if (actual != expected)
+                    {
+                        ++numKernelMismatches;
+                        std::cerr << "Mismatch: Reed-Solomon kernel " << GetRsKernelName(kernel) << ", level " << "LMQH"[level] << ", version " << version << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    return numMismatches + numKernelMismatches;
+}
+
+/**
+ *  \brief  Generates a corpus of short messages, whose CBOR payloads are close to the minimum
+ *          fragment length of the UR encoder.
+ *
+ *  \returns    Number of failures.
+ */
+static int CheckShortCorpus()
+{
+    const auto path = std::filesystem::temp_directory_path() / "qurtest_bench_corpus.bin";
+    CorpusOptions options;
+    options.path = path.string();
+    options.numCases = 2000;
+    options.seed = 1;
+    options.maxMessageLength = 32;
+    options.maxFragmentLength = 100;
+    options.numExtraParts = 2;
+    int numFailures = 0;
+    try
+    {
+        WriteCorpus(options);
+        std::cerr << "Corpus of " << options.numCases << " short messages generated" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        ++numFailures;
+        std::cerr << "Corpus of short messages failed: " << e.what() << std::endl;
+    }
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return numFailures;
+}
+
+/**
+ *  \brief  Runs benchmarks and prints one JSON object per benchmark to stdout.
+ */
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(const CommandLineArguments& args)
+        : m_args(args)
+    {
+    }
+
+    /**
+     *  \brief  Measures a benchmark.
+     *
+     *  The operation is run once to warm up and then in batches of doubling size until the batch
+     *  takes at least the minimum time.
+     *
+     *  \param  name    Benchmark name.
+     *  \param  params  Benchmark parameters as the members of a JSON object.
+     *  \param  op  Measured operation.
+     */
+    void Run(const std::string& name, const std::string& params, const std::function<void()>& op)
+    {
+        if (name.find(m_args.filter) == std::string::npos)
+        {
+            return;
+        }
+
+        op();
+
+        size_t iterations = 1;
+        for (;;)
+        {
+            const auto allocsBefore = GetAllocationStats();
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                op();
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            const auto allocsAfter = GetAllocationStats();
+
+            if (elapsed.count() >= 1e9 * m_args.minTime)
+            {
+                std::cout << "{\"benchmark\":\"" << name << "\""
+                    << ",\"params\":{" << params << "}"
+                    << ",\"iterations\":" << iterations
+                    << ",\"ns_per_op\":" << elapsed.count() / iterations
+                    << ",\"bytes_per_op\":" << static_cast<double>(allocsAfter.bytes - allocsBefore.bytes) / iterations
+                    << ",\"allocs_per_op\":" << static_cast<double>(allocsAfter.count - allocsBefore.count) / iterations
+                    << "}" << std::endl;
+                return;
+            }
+            iterations *= 2;
+        }
+    }
+
+private:
+    const CommandLineArguments m_args;
+};
+
+int main(int argc, char** argv)
+{
+    const auto args = ParseCommandLineArguments(argc, argv);
+    if (args.checkQrEncoder)
+    {
+        const int numFailures = CheckQrEncoder() + CheckShortCorpus();
+        return numFailures == 0 ? 0 : 1;
+    }
+    BenchmarkRunner runner(args);
+
+    // The stages are benchmarked on a single thread.
+    cv::setNumThreads(1);
+
+    const size_t MESSAGE_LENGTHS[] = {100, 1000, 10000, 100000};
+    const size_t FRAGMENT_LENGTHS[] = {100, 500, 1000};
+    const int IMAGE_SIZES[] = {256, 512, 1024};
+
+    for (const auto len : MESSAGE_LENGTHS)
+    {
+        const auto params = "\"len\":" + std::to_string(len);
+        runner.Run("MakeMessage", params, [&]{ Consume(MakeMessage(len, 0)); });
+        runner.Run("MakeMessageUr", params, [&]{ Consume(MakeMessageUr(len, 0)); });
+    }
+
+    for (const auto len : MESSAGE_LENGTHS)
+    {
+        if (GetSinglePartUrLength(GetMessageUrCborLength(len)) > static_cast<size_t>(GetQrCapacity(QR_MAX_VERSION, QR_ECLEVEL_L, QR_MODE_8)))
+        {
+            continue;
+        }
+        const auto message = MakeMessageUr(len, 0);
+        runner.Run("GenerateSinglePartUr", "\"len\":" + std::to_string(len), [&]{ Consume(GenerateSinglePartUr(message)); });
+    }
+
+    for (const auto len : MESSAGE_LENGTHS)
+    {
+        const auto message = MakeMessageUr(len, 0);
+        for (const auto fragmentLen : FRAGMENT_LENGTHS)
+        {
+            if (fragmentLen > len)
+            {
+                continue;
+            }
+            const auto params = "\"len\":" + std::to_string(len) + ",\"fragment_len\":" + std::to_string(fragmentLen);
+            runner.Run("GenerateMultiPartUr", params, [&]{ Consume(GenerateMultiPartUr(message, fragmentLen)); });
+        }
+    }
+
+    const auto message = MakeMessageUr(10000, 0);
+    for (const auto fragmentLen : FRAGMENT_LENGTHS)
+    {
+        const auto ur = GenerateMultiPartUr(message, fragmentLen).front();
+        for (const auto mode : {QrEncodingMode::Byte, QrEncodingMode::Alphanumeric})
+        {
+            QrOptions options;
+            options.mode = mode;
+            const auto params = "\"fragment_len\":" + std::to_string(fragmentLen) + ",\"mode\":\"" + (mode == QrEncodingMode::Byte ? "byte" : "alnum") + "\"";
+            runner.Run("EncodeQr", params, [&]{ Consume(EncodeQr(ur, options)); });
+        }
+
+        const auto qur = EncodeQr(ur, QrOptions());
+        for (const auto size : IMAGE_SIZES)
+        {
+            const auto params = "\"fragment_len\":" + std::to_string(fragmentLen) + ",\"version\":" + std::to_string(qur->version) + ",\"size\":" + std::to_string(size);
+            runner.Run("RasterizeQrResize", params, [&]{ Consume(RasterizeQrResize(qur.get(), size)); });
+            cv::Mat image;
+            runner.Run("RasterizeQr", params, [&]{ RasterizeQr(qur.get(), size, image); Consume(image); });
+        }
+    }
+
+    for (const auto size : {128, 256, 512})
+    {
+        runner.Run("CreateLifeHashImage", "\"size\":" + std::to_string(size), [&]{ Consume(CreateLifeHashImage(message, size)); });
+    }
+
+    cv::RNG rng(1);
+    QrEncoder encoder;
+    for (const int version : {1, 2, 5, 10, 15, 20, 25, 30, 35, 40})
+    {
+        const auto ur = MakeUrLikeString(GetQrCapacity(version, QR_ECLEVEL_L, QR_MODE_8), rng);
+        for (const auto backend : {QrEncoderBackend::Libqrencode, QrEncoderBackend::InTree})
+        {
+            const bool isInTree = backend == QrEncoderBackend::InTree;
+            const auto params = "\"version\":" + std::to_string(version) + ",\"encoder\":\"" + (isInTree ? "intree" : "libqrencode") + "\"";
+            if (isInTree)
+            {
+                runner.Run("EncodeQrVersion", params, [&]{ Consume(encoder.Encode(ur, QrOptions())); });
+            }
+            else
+            {
+                runner.Run("EncodeQrVersion", params, [&]{ Consume(EncodeQr(ur, QrOptions())); });
+            }
+        }
+    }
+
+    for (const int version : {10, 25, 40})
+    {
+        const auto ur = MakeUrLikeString(GetQrCapacity(version, QR_ECLEVEL_L, QR_MODE_8), rng);
+        for (const auto policy : {"full", "fast", "0"})
+        {
+            QrOptions options;
+            ParseQrMaskPolicy(policy, options);
+            const auto params = "\"version\":" + std::to_string(version) + ",\"mask_policy\":\"" + policy + "\"";
+            runner.Run("EncodeQrMask", params, [&]{ Consume(encoder.Encode(ur, options)); });
+        }
+    }
+
+    // Micro QR codes hold at most 35 digits, 21 alphanumeric characters or 15 bytes. The area
+    // includes the quiet zone of 4 modules for QR and 2 modules for Micro QR codes.
+    for (const auto mode : {QR_MODE_NUM, QR_MODE_AN, QR_MODE_8})
+    {
+        static const char* const CHARSETS[] = {"0123456789", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ:/-", "abcdefghijklmnopqrstuvwxyz:/-"};
+        const std::string charset = CHARSETS[mode];
+        for (const int len : {5, 10, 15, 21, 35})
+        {
+            if (len > GetQrMicroCapacity(QR_MICRO_MAX_VERSION, QR_ECLEVEL_L, mode))
+            {
+                continue;
+            }
+            std::string payload(len, ' ');
+            std::generate(payload.begin(), payload.end(), [&]{ return charset[rng.uniform(0, static_cast<int>(charset.size()))]; });
+            for (const bool isMicro : {false, true})
+            {
+                const auto encode = [&]{ return EncodeSingleSegment(payload, mode, isMicro); };
+                const auto qur = encode();
+                if (!qur)
+                {
+                    std::cerr << "EncodeMicroQr: payload of " << len << " characters does not fit, skipped" << std::endl;
+                    continue;
+                }
+                const int side = qur->width + (isMicro ? 4 : 8);
+                const auto params = "\"mode\":\"" + std::string(mode == QR_MODE_NUM ? "numeric" : mode == QR_MODE_AN ? "alnum" : "byte")
+                    + "\",\"payload_len\":" + std::to_string(len) + ",\"symbol\":\"" + (isMicro ? "micro" : "qr")
+                    + "\",\"version\":" + std::to_string(qur->version) + ",\"modules\":" + std::to_string(qur->width)
+                    + ",\"area_with_quiet_zone\":" + std::to_string(side * side);
+                runner.Run("EncodeMicroQr", params, [&]{ Consume(encode()); });
+            }
+        }
+    }
+
+    // libqrencode keeps its Reed-Solomon encoder internal, so the kernels are compared with the
+    // scalar in-tree one; EncodeQrVersion shows the share of the whole encoding.
+    std::vector<uint8_t> codewords;
+    std::vector<uint8_t> ecc;
+    for (const int version : {1, 2, 5, 10, 15, 20, 25, 30, 35, 40})
+    {
+        const auto layout = GetQrBlockLayout(version, QR_ECLEVEL_L);
+        codewords.resize(GetQrDataCodewords(version, QR_ECLEVEL_L));
+        std::generate(codewords.begin(), codewords.end(), [&rng]{ return static_cast<uint8_t>(rng.uniform(0, 256)); });
+        ecc.resize((layout.numShortBlocks + layout.numLongBlocks) * layout.eccLength);
+        for (const auto kernel : {RsKernel::Scalar, RsKernel::Ssse3, RsKernel::Avx2})
+        {
+            if (IsRsKernelSupported(kernel))
+            {
+                const auto params = "\"version\":" + std::to_string(version) + ",\"kernel\":\"" + GetRsKernelName(kernel) + "\"";
+                runner.Run("EncodeRsBlocks", params, [&]{ EncodeRsBlocks(codewords.data(), layout, ecc.data(), kernel); Consume(ecc); });
+            }
+        }
+    }
+
+    const auto lifeHashImage = CreateLifeHashImage(message, 128);
+    const auto qur = EncodeQr(GenerateMultiPartUr(message, 500).front(), QrOptions());
+    for (const auto size : IMAGE_SIZES)
+    {
+        cv::Mat frame;
+        runner.Run("ComposeFrame", "\"size\":" + std::to_string(size), [&]{ ComposeFrame(lifeHashImage, qur.get(), size, frame); Consume(frame); });
+    }
+
+    return 0;
+}
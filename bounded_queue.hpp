@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ *  \brief  A blocking FIFO queue with a fixed capacity.
+ *
+ *  Producers block while the queue is full and consumers block while it is empty. Closing the
+ *  queue wakes all waiting threads; pushing to a closed queue fails and popping from it succeeds
+ *  until the remaining items are drained.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    /**
+     *  \brief  Creates an empty queue.
+     *  \param  capacity    Maximum number of queued items.
+     */
+    explicit BoundedQueue(const size_t capacity)
+        : m_capacity(std::max<size_t>(1, capacity))
+    {
+    }
+
+    /**
+     *  \brief  Appends an item, waiting for a free slot.
+     *  \param  item    Item to append.
+     *  \returns    False if the queue was closed.
+     */
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]{ return m_closed || m_items.size() < m_capacity; });
+        if (m_closed)
+        {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     *  \brief  Removes the oldest item, waiting for one to arrive.
+     *  \param  item    Removed item.
+     *  \returns    False if the queue is closed and empty.
+     */
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]{ return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+        {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    /**
+     *  \brief  Removes the oldest item if there is one, without waiting.
+     *  \param  item    Removed item.
+     *  \returns    False if the queue is empty.
+     */
+    bool TryPop(T& item)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty())
+        {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    /**
+     *  \brief  Closes the queue and wakes all waiting threads.
+     */
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    const size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
@@ -0,0 +1,300 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "camera_sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "pipeline_stats.hpp"
+
+namespace
+{
+
+/// Displayed frames and their weights in the exposure of a sensor row.
+using Weights = std::vector<std::pair<size_t, double>>;
+
+/// Largest weight difference of rows that are blended together, below one intensity level.
+constexpr double WEIGHT_TOLERANCE = 1.0 / 512;
+
+/**
+ *  \brief  Returns the displayed frames that overlap an exposure interval and their weights.
+ *  \param  start   Start of the exposure in seconds.
+ *  \param  exposure    Exposure time in seconds.
+ *  \param  displayFps  Number of displayed frames per second.
+ */
+Weights GetRowWeights(const double start, const double exposure, const double displayFps)
+{
+    Weights result;
+    const auto first = static_cast<size_t>(std::floor(start * displayFps));
+    if (exposure <= 0)
+    {
+        result.emplace_back(first, 1.0);
+        return result;
+    }
+    const double end = start + exposure;
+    const auto last = static_cast<size_t>(std::ceil(end * displayFps));
+    for (size_t k = first; k < last; ++k)
+    {
+        const double overlap = std::min(end, (k + 1) / displayFps) - std::max(start, k / displayFps);
+        if (overlap > exposure * 1e-6)
+        {
+            result.emplace_back(k, overlap / exposure);
+        }
+    }
+    return result;
+}
+
+bool IsSameWeights(const Weights& a, const Weights& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].first != b[i].first || std::abs(a[i].second - b[i].second) > WEIGHT_TOLERANCE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ *  \brief  Sensor rows that are blended with the same weights.
+ */
+struct Band
+{
+    int begin;
+    int end;
+    Weights weights;
+};
+
+/**
+ *  \brief  Returns the displayed frame with the largest weight.
+ */
+size_t GetDominantFrame(const Weights& weights)
+{
+    return std::max_element(weights.begin(), weights.end(), [](const auto& a, const auto& b){ return a.second < b.second; })->first;
+}
+
+}
+
+CameraOptions ParseCameraOptions(const std::string& spec)
+{
+    CameraOptions result;
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        const auto separator = item.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::invalid_argument("Camera parameter " + item + " has no value");
+        }
+        const auto key = item.substr(0, separator);
+        const auto value = item.substr(separator + 1);
+        if (key == "fps")
+        {
+            result.fps = std::stod(value);
+        }
+        else if (key == "exposure")
+        {
+            result.exposure = std::stod(value);
+        }
+        else if (key == "readout")
+        {
+            result.readout = std::stod(value);
+        }
+        else if (key == "drop")
+        {
+            result.dropRate = std::stod(value);
+        }
+        else if (key == "phase")
+        {
+            result.phase = std::stod(value);
+        }
+        else if (key == "seed")
+        {
+            result.seed = std::stoull(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown camera parameter " + key);
+        }
+    }
+    if (result.fps <= 0 || result.exposure < 0 || result.readout < 0 || result.dropRate < 0 || result.dropRate > 1)
+    {
+        throw std::invalid_argument("Invalid camera parameters " + spec);
+    }
+    return result;
+}
+
+void PrintCameraStats(const CameraStats& stats, std::ostream& os)
+{
+    os << "Camera: captures " << stats.captures
+        << ", dropped " << stats.dropped
+        << ", blended " << stats.blended
+        << ", torn " << stats.torn
+        << ", clean parts " << stats.cleanParts
+        << " in " << std::fixed << std::setprecision(3) << stats.duration << " s";
+    if (stats.duration > 0)
+    {
+        os << " (" << stats.cleanParts / stats.duration << " parts/s)";
+    }
+    os << std::defaultfloat << std::endl;
+}
+
+CameraSimulator::CameraSimulator(FrameSource source, const size_t cycleLength, const double displayFps, const CameraOptions& options)
+    : m_source(std::move(source))
+    , m_cycleLength(cycleLength)
+    , m_displayFps(displayFps)
+    , m_options(options)
+{
+}
+
+size_t CameraSimulator::CycleLength() const
+{
+    return static_cast<size_t>(std::ceil(m_cycleLength / m_displayFps * m_options.fps));
+}
+
+bool CameraSimulator::Next(Frame& frame)
+{
+    const double exposure = m_options.exposure / 1000;
+    const double readout = m_options.readout / 1000;
+    for (;;)
+    {
+        const size_t index = m_captureIndex;
+        const double start = (index + m_options.phase) / m_options.fps;
+        const auto lastWeights = GetRowWeights(start + readout, exposure, m_displayFps);
+        if (!Fetch(lastWeights.back().first))
+        {
+            return false;
+        }
+        const auto firstFrame = static_cast<size_t>(std::floor(start * m_displayFps));
+        while (m_firstFrame < firstFrame && !m_frames.empty())
+        {
+            m_frames.pop_front();
+            ++m_firstFrame;
+        }
+
+        ++m_captureIndex;
+        ++m_stats.captures;
+        m_stats.duration = m_captureIndex / m_options.fps;
+        cv::RNG rng(m_options.seed ^ (0x9e3779b97f4a7c15ULL * (index + 1)));
+        if (m_options.dropRate > 0 && rng.uniform(0.0, 1.0) < m_options.dropRate)
+        {
+            ++m_stats.dropped;
+            continue;
+        }
+
+        StageTimer timer(Stage::Capture);
+        const auto& reference = m_frames.front().image;
+        const int height = reference.rows;
+        std::vector<Band> bands;
+        for (int y = 0; y < height; ++y)
+        {
+            auto weights = GetRowWeights(start + readout * y / height, exposure, m_displayFps);
+            if (!bands.empty() && IsSameWeights(bands.back().weights, weights))
+            {
+                bands.back().end = y + 1;
+            }
+            else
+            {
+                bands.push_back(Band{y, y + 1, std::move(weights)});
+            }
+        }
+
+        frame.index = index;
+        // A new buffer, the previous capture may still be referenced by the consumer.
+        frame.image = cv::Mat(reference.size(), reference.type());
+        frame.lease.reset();
+        cv::parallel_for_(cv::Range(0, static_cast<int>(bands.size())), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; ++i)
+            {
+                const auto& band = bands[i];
+                const auto rows = [&](const size_t k){ return m_frames[k - m_firstFrame].image.rowRange(band.begin, band.end); };
+                auto target = frame.image.rowRange(band.begin, band.end);
+                const auto& weights = band.weights;
+                if (weights.size() == 1)
+                {
+                    rows(weights[0].first).copyTo(target);
+                    continue;
+                }
+                cv::addWeighted(rows(weights[0].first), weights[0].second, rows(weights[1].first), weights[1].second, 0, target);
+                for (size_t j = 2; j < weights.size(); ++j)
+                {
+                    cv::addWeighted(target, 1, rows(weights[j].first), weights[j].second, 0, target);
+                }
+            }
+        });
+
+        std::map<size_t, double> coverage;
+        bool isBlended = false;
+        bool isTorn = false;
+        for (const auto& band : bands)
+        {
+            isBlended = isBlended || band.weights.size() > 1;
+            isTorn = isTorn || GetDominantFrame(band.weights) != GetDominantFrame(bands.front().weights);
+            for (const auto& [k, weight] : band.weights)
+            {
+                coverage[k] += weight * (band.end - band.begin);
+            }
+        }
+        const auto dominant = std::max_element(coverage.begin(), coverage.end(), [](const auto& a, const auto& b){ return a.second < b.second; })->first;
+        frame.ur = m_frames[dominant - m_firstFrame].ur;
+
+        m_stats.blended += isBlended;
+        m_stats.torn += isTorn;
+        // Displayed frames are captured in order, so one counter finds the first clean capture of each.
+        if (!isBlended && !isTorn && dominant >= m_nextCleanFrame)
+        {
+            ++m_stats.cleanParts;
+            m_nextCleanFrame = dominant + 1;
+        }
+        return true;
+    }
+}
+
+CameraStats CameraSimulator::Stats() const
+{
+    return m_stats;
+}
+
+bool CameraSimulator::Fetch(const size_t index)
+{
+    while (m_firstFrame + m_frames.size() <= index)
+    {
+        Frame frame;
+        if (!m_source(frame))
+        {
+            return false;
+        }
+        m_frames.push_back(std::move(frame));
+    }
+    return true;
+}
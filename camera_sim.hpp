@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include "frame_stream.hpp"
+
+/**
+ *  \brief  Parameters of a simulated camera that films the displayed frames.
+ *
+ *  The display shows frame k during [k / displayFps, (k + 1) / displayFps). Capture j starts at
+ *  (j + phase) / fps; row y of the sensor starts exposing readout * y / height later and
+ *  integrates the display for the exposure time.
+ */
+struct CameraOptions
+{
+    /// Number of captures per second.
+    double fps = 30;
+    /// Exposure time in milliseconds. An instantaneous sample is taken when 0.
+    double exposure = 0;
+    /// Time between the exposure of the first and the last sensor row in milliseconds, 0 for a global shutter.
+    double readout = 0;
+    /// Probability that a capture is dropped.
+    double dropRate = 0;
+    /// Start of the first capture as a fraction of the capture period.
+    double phase = 0;
+    /// Seed of the dropped captures.
+    uint64_t seed = 0;
+};
+
+/**
+ *  \brief  Parses camera parameters.
+ *
+ *  The specification is a comma separated list of key=value pairs with the keys fps, exposure,
+ *  readout, drop, phase and seed, e.g. "fps=30,exposure=16,readout=20,drop=0.05". Throws
+ *  std::invalid_argument on unknown keys.
+ *
+ *  \param  spec    Camera specification.
+ *  \returns    Camera parameters.
+ */
+CameraOptions ParseCameraOptions(const std::string& spec);
+
+/**
+ *  \brief  Counters of a camera simulation.
+ */
+struct CameraStats
+{
+    /// Number of captures including the dropped ones.
+    size_t captures = 0;
+    /// Number of dropped captures.
+    size_t dropped = 0;
+    /// Number of captures that mix several displayed frames.
+    size_t blended = 0;
+    /// Number of captures whose rows are dominated by different displayed frames.
+    size_t torn = 0;
+    /// Number of displayed frames captured at least once without mixing. Each loop of a repeating
+    /// UR sequence counts its parts again.
+    size_t cleanParts = 0;
+    /// Simulated time in seconds.
+    double duration = 0;
+};
+
+/**
+ *  \brief  Prints the counters of a camera simulation and the resulting part throughput.
+ *  \param  stats   Camera counters.
+ *  \param  os  Output stream.
+ */
+void PrintCameraStats(const CameraStats& stats, std::ostream& os);
+
+/// Returns the next displayed frame, or false at the end of the stream.
+using FrameSource = std::function<bool(Frame&)>;
+
+/**
+ *  \brief  Turns the displayed frames of a stream into the frames a camera would capture.
+ *
+ *  Each row of a capture is the average of the displayed frames weighted by their overlap with
+ *  the exposure interval of the row, so a capture that straddles a frame transition is blended
+ *  and a rolling shutter tears it. Rows with the same weights are blended together. Only the
+ *  displayed frames overlapping the current capture are kept.
+ */
+class CameraSimulator
+{
+public:
+    /**
+     *  \brief  Creates a camera that films a stream.
+     *  \param  source  Source of the displayed frames, e.g. FrameStream::Next.
+     *  \param  cycleLength Number of displayed frames before the UR sequence repeats.
+     *  \param  displayFps  Number of displayed frames per second.
+     *  \param  options Camera parameters.
+     */
+    CameraSimulator(FrameSource source, const size_t cycleLength, const double displayFps, const CameraOptions& options);
+
+    /**
+     *  \brief  Returns the number of captures that film one cycle of the UR sequence.
+     */
+    size_t CycleLength() const;
+
+    /**
+     *  \brief  Returns the next capture that is not dropped.
+     *
+     *  The frame index is the capture index, so dropped captures leave gaps. The UR string is the
+     *  one of the displayed frame with the largest weight.
+     *
+     *  \param  frame   The next capture.
+     *  \returns    False if the stream ends before the capture is complete.
+     */
+    bool Next(Frame& frame);
+
+    /**
+     *  \brief  Returns the counters of the captures so far.
+     */
+    CameraStats Stats() const;
+
+private:
+    bool Fetch(const size_t index);
+
+    const FrameSource m_source;
+    const size_t m_cycleLength;
+    const double m_displayFps;
+    const CameraOptions m_options;
+    std::deque<Frame> m_frames;
+    size_t m_firstFrame = 0;
+    size_t m_captureIndex = 0;
+    CameraStats m_stats;
+    /// Displayed frames before this one were already counted as clean parts.
+    size_t m_nextCleanFrame = 0;
+};
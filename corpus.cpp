@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+#include <bc-ur/crypto_utils.hpp>
+#include <bc-ur/ur-encoder.hpp>
+
+#include "qur.hpp"
+
+namespace
+{
+
+/**
+ *  \brief  A generated case before its data is placed in the file.
+ */
+struct GeneratedCase
+{
+    CorpusCase info{};
+    ur::ByteVector payload;
+    std::vector<std::string> parts;
+};
+
+GeneratedCase GenerateCase(const CorpusOptions& options, const size_t index)
+{
+    GeneratedCase result;
+    auto& info = result.info;
+    info.seed = static_cast<uint32_t>(options.seed + index);
+
+    std::mt19937 rng(info.seed);
+    // Shorter messages have CBOR payloads below the minimum fragment length and cannot be split.
+    const size_t minMessageLength = GetMinMultiPartMessageLength();
+    info.messageLength = std::uniform_int_distribution<uint32_t>(minMessageLength, std::max(minMessageLength, options.maxMessageLength))(rng);
+    const size_t cborLength = GetMessageUrCborLength(info.messageLength);
+    const size_t maxFragmentLength = std::min(std::max(UR_MIN_FRAGMENT_LENGTH, options.maxFragmentLength), cborLength);
+    info.maxFragmentLength = std::uniform_int_distribution<uint32_t>(UR_MIN_FRAGMENT_LENGTH, maxFragmentLength)(rng);
+
+    result.payload = MakeMessage(info.messageLength, info.seed);
+    const auto digest = ur::sha256(result.payload);
+    std::copy(digest.begin(), digest.end(), info.sha256);
+
+    ur::ByteVector cbor;
+    ur::CborLite::encodeBytes(cbor, result.payload);
+    info.checksum = ur::crc32_int(cbor);
+
+    ur::UREncoder encoder(ur::UR("bytes", cbor), info.maxFragmentLength);
+    info.seqLen = static_cast<uint32_t>(encoder.seq_len());
+    info.numParts = static_cast<uint32_t>(encoder.seq_len() + options.numExtraParts);
+    for (uint32_t i = 0; i < info.numParts; ++i)
+    {
+        result.parts.push_back(encoder.next_part());
+    }
+    return result;
+}
+
+void Write(std::ofstream& file, const void* data, const size_t size)
+{
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+void Align(std::ofstream& file, uint64_t& offset)
+{
+    static const char ZEROS[8] = {};
+    const uint64_t padding = (8 - offset % 8) % 8;
+    Write(file, ZEROS, padding);
+    offset += padding;
+}
+
+}
+
+void WriteCorpus(const CorpusOptions& options)
+{
+    std::ofstream file(options.path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot create corpus " + options.path);
+    }
+
+    CorpusHeader header{};
+    std::memcpy(header.magic, CORPUS_MAGIC, sizeof(header.magic));
+    header.version = CORPUS_VERSION;
+    header.numCases = static_cast<uint32_t>(options.numCases);
+    Write(file, &header, sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    std::vector<CorpusCase> cases;
+    std::vector<CorpusPart> parts;
+    const size_t BATCH_SIZE = 256;
+    std::vector<GeneratedCase> batch;
+    for (size_t first = 0; first < options.numCases; first += BATCH_SIZE)
+    {
+        batch.assign(std::min(BATCH_SIZE, options.numCases - first), GeneratedCase());
+        cv::parallel_for_(cv::Range(0, static_cast<int>(batch.size())), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; ++i)
+            {
+                batch[i] = GenerateCase(options, first + i);
+            }
+        });
+
+        for (auto& generated : batch)
+        {
+            generated.info.payloadOffset = offset;
+            generated.info.firstPart = parts.size();
+            Write(file, generated.payload.data(), generated.payload.size());
+            offset += generated.payload.size();
+
+            for (uint32_t i = 0; i < generated.parts.size(); ++i)
+            {
+                const auto& part = generated.parts[i];
+                parts.push_back(CorpusPart{offset, static_cast<uint32_t>(part.size()), i + 1});
+                Write(file, part.data(), part.size());
+                offset += part.size();
+            }
+            cases.push_back(generated.info);
+        }
+    }
+
+    Align(file, offset);
+    header.casesOffset = offset;
+    Write(file, cases.data(), cases.size() * sizeof(CorpusCase));
+    offset += cases.size() * sizeof(CorpusCase);
+
+    header.partsOffset = offset;
+    header.numParts = parts.size();
+    Write(file, parts.data(), parts.size() * sizeof(CorpusPart));
+
+    file.seekp(0);
+    Write(file, &header, sizeof(header));
+    if (!file)
+    {
+        throw std::runtime_error("Cannot write corpus " + options.path);
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ *  \file
+ *  Binary test-vector corpus.
+ *
+ *  The file is meant to be memory-mapped and used in place. All integers are stored in the native
+ *  (little-endian) byte order, all offsets are relative to the start of the file and the tables
+ *  are 8-byte aligned. The layout is:
+ *
+ *      CorpusHeader
+ *      data        payloads and UR strings, referenced by offset and length
+ *      CorpusCase  [numCases] at casesOffset
+ *      CorpusPart  [numParts] at partsOffset
+ */
+
+/// Magic bytes at the start of a corpus file.
+constexpr char CORPUS_MAGIC[8] = {'Q', 'U', 'R', 'C', 'O', 'R', 'P', 'S'};
+/// Version of the corpus layout.
+constexpr uint32_t CORPUS_VERSION = 1;
+
+/**
+ *  \brief  Header of a corpus file.
+ */
+struct CorpusHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numCases;
+    uint64_t numParts;
+    uint64_t casesOffset;
+    uint64_t partsOffset;
+};
+
+/**
+ *  \brief  A test case: one message and the UR parts that encode it.
+ *
+ *  The message is the one generated by MakeMessage(messageLength, seed), so a case can also be
+ *  reproduced with "qurtest --seed <seed> -l <messageLength> -f <maxFragmentLength>".
+ */
+struct CorpusCase
+{
+    /// Seed of the message.
+    uint32_t seed;
+    /// Message length in bytes.
+    uint32_t messageLength;
+    /// Maximum fragment length in bytes.
+    uint32_t maxFragmentLength;
+    /// Number of pure parts.
+    uint32_t seqLen;
+    /// Offset of the message bytes.
+    uint64_t payloadOffset;
+    /// Index of the first part in the part table.
+    uint64_t firstPart;
+    /// Number of parts, pure and extra.
+    uint32_t numParts;
+    /// CRC32 of the UR CBOR payload, the checksum carried by every part.
+    uint32_t checksum;
+    /// SHA-256 of the message bytes.
+    uint8_t sha256[32];
+};
+
+/**
+ *  \brief  A UR string of a part. It is not NUL terminated.
+ */
+struct CorpusPart
+{
+    /// Offset of the string.
+    uint64_t offset;
+    /// Length of the string.
+    uint32_t length;
+    /// Sequence number of the part.
+    uint32_t seqNum;
+};
+
+static_assert(sizeof(CorpusHeader) == 40, "Unexpected corpus header layout");
+static_assert(sizeof(CorpusCase) == 72, "Unexpected corpus case layout");
+static_assert(sizeof(CorpusPart) == 16, "Unexpected corpus part layout");
+
+/**
+ *  \brief  Settings of a corpus.
+ */
+struct CorpusOptions
+{
+    /// Output file.
+    std::string path;
+    /// Number of cases.
+    size_t numCases = 1000;
+    /// Seed of the first case. Case i uses seed + i.
+    uint32_t seed = 0;
+    /// Maximum message length in bytes.
+    size_t maxMessageLength = 100;
+    /// Maximum fragment length in bytes.
+    size_t maxFragmentLength = 100;
+    /// Number of extra parts per case.
+    size_t numExtraParts = 0;
+};
+
+/**
+ *  \brief  Generates a corpus of test vectors and writes it to a file.
+ *
+ *  The message length of each case is drawn from [GetMinMultiPartMessageLength(),
+ *  maxMessageLength] and the fragment length from [10, maxFragmentLength], limited to the CBOR
+ *  length of the case, by a generator seeded with the case seed. Cases are generated in parallel
+ *  batches and written in order, so the file depends only on the options. Throws on I/O errors.
+ *
+ *  \param  options Corpus settings.
+ */
+void WriteCorpus(const CorpusOptions& options);
@@ -0,0 +1,233 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "degrade.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+bool DegradationOptions::IsEnabled() const
+{
+    return rotation != 0 || perspective != 0 || glare != 0 || blur != 0 || motionBlur != 0
+        || gamma != 1 || brightness != 0 || noise != 0 || jpegQuality != 0;
+}
+
+DegradationOptions ParseDegradationOptions(const std::string& spec)
+{
+    DegradationOptions result;
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        const auto separator = item.find('=');
+        if (separator == std::string::npos)
+        {
+            throw std::invalid_argument("Degradation " + item + " has no value");
+        }
+        const auto key = item.substr(0, separator);
+        const auto value = item.substr(separator + 1);
+        if (key == "rotation")
+        {
+            result.rotation = std::stod(value);
+        }
+        else if (key == "perspective")
+        {
+            result.perspective = std::stod(value);
+        }
+        else if (key == "glare")
+        {
+            result.glare = std::stod(value);
+        }
+        else if (key == "blur")
+        {
+            result.blur = std::stod(value);
+        }
+        else if (key == "motion")
+        {
+            result.motionBlur = std::stod(value);
+        }
+        else if (key == "gamma")
+        {
+            result.gamma = std::stod(value);
+        }
+        else if (key == "brightness")
+        {
+            result.brightness = std::stod(value);
+        }
+        else if (key == "noise")
+        {
+            result.noise = std::stod(value);
+        }
+        else if (key == "jpeg")
+        {
+            result.jpegQuality = std::stoi(value);
+        }
+        else if (key == "seed")
+        {
+            result.seed = std::stoull(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown degradation " + key);
+        }
+    }
+    return result;
+}
+
+/**
+ *  \brief  Warps a frame by a random rotation and a random displacement of its corners.
+ */
+static void Warp(cv::Mat& frame, const DegradationOptions& options, cv::RNG& rng)
+{
+    const cv::Point2f center(0.5f * frame.cols, 0.5f * frame.rows);
+    const double angle = options.rotation * CV_PI / 180 * rng.uniform(-1.0, 1.0);
+    const float maxShift = static_cast<float>(options.perspective * std::max(frame.cols, frame.rows));
+
+    const cv::Point2f src[4] = {{0, 0}, {float(frame.cols), 0}, {float(frame.cols), float(frame.rows)}, {0, float(frame.rows)}};
+    cv::Point2f dst[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float x = src[i].x - center.x;
+        const float y = src[i].y - center.y;
+        dst[i].x = center.x + static_cast<float>(x * std::cos(angle) - y * std::sin(angle)) + maxShift * rng.uniform(-1.0f, 1.0f);
+        dst[i].y = center.y + static_cast<float>(x * std::sin(angle) + y * std::cos(angle)) + maxShift * rng.uniform(-1.0f, 1.0f);
+    }
+
+    cv::Mat warped;
+    cv::warpPerspective(frame, warped, cv::getPerspectiveTransform(src, dst), frame.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(255, 255, 255));
+    frame = warped;
+}
+
+/**
+ *  \brief  Adds a Gaussian glare spot at a random position.
+ *
+ *  The spot is smooth, so it is computed at a fraction of the frame resolution and upscaled.
+ */
+static void AddGlare(cv::Mat& frame, const DegradationOptions& options, cv::RNG& rng)
+{
+    const int SCALE = 8;
+    const cv::Size size((frame.cols + SCALE - 1) / SCALE, (frame.rows + SCALE - 1) / SCALE);
+    const float cx = rng.uniform(0.0f, float(size.width));
+    const float cy = rng.uniform(0.0f, float(size.height));
+    const float sigma = rng.uniform(0.15f, 0.4f) * std::max(size.width, size.height);
+    const float peak = static_cast<float>(options.glare * 255);
+
+    cv::Mat glare(size, CV_8U);
+    for (int r = 0; r < size.height; ++r)
+    {
+        uchar* row = glare.ptr<uchar>(r);
+        const float dy = r - cy;
+        for (int c = 0; c < size.width; ++c)
+        {
+            const float dx = c - cx;
+            row[c] = cv::saturate_cast<uchar>(peak * std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma)));
+        }
+    }
+    cv::resize(glare, glare, frame.size(), 0, 0, cv::INTER_LINEAR);
+    cv::cvtColor(glare, glare, cv::COLOR_GRAY2BGR);
+    cv::add(frame, glare, frame);
+}
+
+/**
+ *  \brief  Blurs a frame along a line of a random direction.
+ */
+static void AddMotionBlur(cv::Mat& frame, const DegradationOptions& options, cv::RNG& rng)
+{
+    const int size = static_cast<int>(std::ceil(options.motionBlur)) | 1;
+    const double angle = rng.uniform(0.0, CV_PI);
+    cv::Mat kernel = cv::Mat::zeros(size, size, CV_32F);
+    const cv::Point center(size / 2, size / 2);
+    const cv::Point offset(static_cast<int>(std::round(std::cos(angle) * size / 2)), static_cast<int>(std::round(std::sin(angle) * size / 2)));
+    cv::line(kernel, cv::Point(center.x - offset.x, center.y - offset.y), cv::Point(center.x + offset.x, center.y + offset.y), cv::Scalar(1));
+    kernel *= 1.0 / cv::sum(kernel)[0];
+    cv::filter2D(frame, frame, -1, kernel, cv::Point(-1, -1), 0, cv::BORDER_REPLICATE);
+}
+
+/**
+ *  \brief  Applies gamma and brightness through a lookup table.
+ */
+static void AdjustTone(cv::Mat& frame, const DegradationOptions& options)
+{
+    cv::Mat table(1, 256, CV_8U);
+    for (int i = 0; i < 256; ++i)
+    {
+        table.at<uchar>(0, i) = cv::saturate_cast<uchar>(255 * std::pow(i / 255.0, options.gamma) + options.brightness);
+    }
+    cv::LUT(frame, table, frame);
+}
+
+/**
+ *  \brief  Adds zero-mean Gaussian sensor noise.
+ */
+static void AddNoise(cv::Mat& frame, const DegradationOptions& options, cv::RNG& rng)
+{
+    cv::Mat noise(frame.size(), CV_16SC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(options.noise));
+    cv::add(frame, noise, frame, cv::noArray(), frame.type());
+}
+
+/**
+ *  \brief  Encodes and decodes a frame as JPEG.
+ */
+static void Recompress(cv::Mat& frame, const DegradationOptions& options)
+{
+    std::vector<uchar> buffer;
+    cv::imencode(".jpg", frame, buffer, {cv::IMWRITE_JPEG_QUALITY, options.jpegQuality});
+    frame = cv::imdecode(buffer, cv::IMREAD_COLOR);
+}
+
+void DegradeFrame(cv::Mat& frame, const DegradationOptions& options, const size_t index)
+{
+    // Mix the index so that consecutive frames get unrelated generator states.
+    cv::RNG rng(options.seed ^ (0x9e3779b97f4a7c15ULL * (index + 1)));
+
+    if (options.rotation != 0 || options.perspective != 0)
+    {
+        Warp(frame, options, rng);
+    }
+    if (options.glare != 0)
+    {
+        AddGlare(frame, options, rng);
+    }
+    if (options.blur != 0)
+    {
+        cv::GaussianBlur(frame, frame, cv::Size(), options.blur);
+    }
+    if (options.motionBlur != 0)
+    {
+        AddMotionBlur(frame, options, rng);
+    }
+    if (options.gamma != 1 || options.brightness != 0)
+    {
+        AdjustTone(frame, options);
+    }
+    if (options.noise != 0)
+    {
+        AddNoise(frame, options, rng);
+    }
+    if (options.jpegQuality != 0)
+    {
+        Recompress(frame, options);
+    }
+}
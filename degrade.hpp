@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  \brief  Parameters of the degradations applied to composed frames.
+ *
+ *  Every degradation is disabled by its default value. Random quantities, such as the rotation
+ *  angle or the noise, are drawn per frame from a generator seeded by the seed and the frame index.
+ */
+struct DegradationOptions
+{
+    /// Maximum rotation in degrees.
+    double rotation = 0;
+    /// Maximum displacement of the frame corners as a fraction of the frame size.
+    double perspective = 0;
+    /// Peak brightness of a glare spot as a fraction of the full range.
+    double glare = 0;
+    /// Standard deviation of the Gaussian blur in pixels.
+    double blur = 0;
+    /// Length of the motion blur in pixels.
+    double motionBlur = 0;
+    /// Gamma of the sensor response.
+    double gamma = 1;
+    /// Brightness offset in intensity levels.
+    double brightness = 0;
+    /// Standard deviation of the sensor noise in intensity levels.
+    double noise = 0;
+    /// Quality of the JPEG re-compression, disabled when 0.
+    int jpegQuality = 0;
+    /// Seed of the random quantities.
+    uint64_t seed = 0;
+
+    /**
+     *  \brief  Returns true if at least one degradation is enabled.
+     */
+    bool IsEnabled() const;
+};
+
+/**
+ *  \brief  Parses degradation parameters.
+ *
+ *  The specification is a comma separated list of key=value pairs with the keys rotation,
+ *  perspective, glare, blur, motion, gamma, brightness, noise, jpeg and seed, e.g.
+ *  "blur=1.5,noise=8,jpeg=40". Throws std::invalid_argument on unknown keys.
+ *
+ *  \param  spec    Degradation specification.
+ *  \returns    Degradation parameters.
+ */
+DegradationOptions ParseDegradationOptions(const std::string& spec);
+
+/**
+ *  \brief  Degrades a frame in place.
+ *
+ *  The degradations are applied in the order of the imaging chain: perspective warp with rotation,
+ *  glare, optical blur, motion blur, gamma and brightness, sensor noise and JPEG re-compression.
+ *  The result depends only on the frame, the parameters and the frame index.
+ *
+ *  \param  frame   BGR frame.
+ *  \param  options Degradation parameters.
+ *  \param  index   Position of the frame in the stream.
+ */
+void DegradeFrame(cv::Mat& frame, const DegradationOptions& options, const size_t index);
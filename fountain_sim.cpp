@@ -0,0 +1,204 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fountain_sim.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <bc-ur/bc-ur.hpp>
+#include <bc-ur/fountain-decoder.hpp>
+#include <bc-ur/fountain-encoder.hpp>
+
+#include "qur.hpp"
+
+namespace
+{
+
+/**
+ *  \brief  Decides which parts are lost.
+ *
+ *  The Gilbert-Elliott model loses every part in the bad state and none in the good one. The
+ *  transition probabilities are chosen so the stationary loss rate and the mean burst length
+ *  match the requested ones.
+ */
+class LossChannel
+{
+public:
+    LossChannel(const double lossRate, const double meanBurstLength, const uint64_t seed)
+        : m_rng(seed)
+    {
+        if (meanBurstLength <= 1 || lossRate >= 1)
+        {
+            m_isBernoulli = true;
+            m_lossRate = lossRate;
+        }
+        else
+        {
+            m_badToGood = 1 / meanBurstLength;
+            m_goodToBad = std::min(1.0, lossRate * m_badToGood / (1 - lossRate));
+            m_isBad = m_uniform(m_rng) < lossRate;
+        }
+    }
+
+    bool Drop()
+    {
+        if (m_isBernoulli)
+        {
+            return m_uniform(m_rng) < m_lossRate;
+        }
+        m_isBad = m_uniform(m_rng) < (m_isBad ? 1 - m_badToGood : m_goodToBad);
+        return m_isBad;
+    }
+
+private:
+    std::mt19937_64 m_rng;
+    std::uniform_real_distribution<double> m_uniform;
+    bool m_isBernoulli = false;
+    double m_lossRate = 0;
+    double m_goodToBad = 0;
+    double m_badToGood = 0;
+    bool m_isBad = false;
+};
+
+/**
+ *  \brief  Creates the CBOR payload of the message of a trial. Trial i uses the message of seed + i.
+ */
+ur::ByteVector MakeTrialMessage(const size_t len, const uint32_t seed, const size_t trial)
+{
+    return MakeMessageUr(len, static_cast<uint32_t>(seed + trial)).cbor();
+}
+
+}
+
+FountainSimulationResult RunFountainSimulation(const FountainSimulationOptions& options)
+{
+    FountainSimulationResult result;
+    result.seqLen = ur::FountainEncoder(MakeTrialMessage(options.messageLength, options.seed, 0), options.maxFragmentLength).seq_len();
+    const size_t maxParts = options.maxPartsFactor * result.seqLen;
+
+    const unsigned numThreads = options.numThreads > 0 ? options.numThreads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<FountainSimulationResult> partial(numThreads);
+    std::atomic<size_t> nextTrial{0};
+
+    const auto worker = [&](FountainSimulationResult& local)
+    {
+        local.partsSent.assign(maxParts + 1, 0);
+        local.partsReceived.assign(maxParts + 1, 0);
+        for (size_t trial = nextTrial++; trial < options.numTrials; trial = nextTrial++)
+        {
+            ur::FountainEncoder encoder(MakeTrialMessage(options.messageLength, options.seed, trial), options.maxFragmentLength);
+            ur::FountainDecoder decoder;
+            LossChannel channel(options.lossRate, options.meanBurstLength, options.seed ^ (trial * 0xbf58476d1ce4e5b9ULL));
+
+            size_t sent = 0;
+            size_t received = 0;
+            while (!decoder.is_complete() && sent < maxParts)
+            {
+                auto part = encoder.next_part();
+                ++sent;
+                if (!channel.Drop())
+                {
+                    ++received;
+                    decoder.receive_part(part);
+                }
+            }
+
+            if (decoder.is_success())
+            {
+                ++local.partsSent[sent];
+                ++local.partsReceived[received];
+            }
+            else
+            {
+                ++local.failures;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back(worker, std::ref(partial[i]));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    result.partsSent.assign(maxParts + 1, 0);
+    result.partsReceived.assign(maxParts + 1, 0);
+    for (const auto& local : partial)
+    {
+        for (size_t i = 0; i <= maxParts; ++i)
+        {
+            result.partsSent[i] += local.partsSent[i];
+            result.partsReceived[i] += local.partsReceived[i];
+        }
+        result.failures += local.failures;
+    }
+    return result;
+}
+
+void PrintFountainSimulation(const FountainSimulationResult& result, std::ostream& os)
+{
+    size_t successes = 0;
+    for (const auto count : result.partsSent)
+    {
+        successes += count;
+    }
+    const size_t trials = successes + result.failures;
+
+    // Smallest number of sent parts that completes the given fraction of all trials.
+    const auto percentile = [&](const double p)
+    {
+        size_t cumulative = 0;
+        for (size_t parts = 0; parts < result.partsSent.size(); ++parts)
+        {
+            cumulative += result.partsSent[parts];
+            if (cumulative >= p * trials)
+            {
+                return std::to_string(parts) + " (+" + std::to_string(parts - std::min(parts, result.seqLen)) + " extra)";
+            }
+        }
+        return std::string("not reached");
+    };
+
+    std::cerr << "Trials: " << trials << ", sequence length: " << result.seqLen << ", failures: " << result.failures << std::endl;
+    std::cerr << "Parts sent to complete: p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+        << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << std::endl;
+
+    os << "parts,sent,sent_cdf,received,received_cdf" << std::endl;
+    size_t sentCumulative = 0;
+    size_t receivedCumulative = 0;
+    for (size_t parts = 0; parts < result.partsSent.size(); ++parts)
+    {
+        if (result.partsSent[parts] == 0 && result.partsReceived[parts] == 0)
+        {
+            continue;
+        }
+        sentCumulative += result.partsSent[parts];
+        receivedCumulative += result.partsReceived[parts];
+        os << parts << "," << result.partsSent[parts] << "," << static_cast<double>(sentCumulative) / trials
+            << "," << result.partsReceived[parts] << "," << static_cast<double>(receivedCumulative) / trials << std::endl;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ *  \brief  Settings of a fountain code simulation.
+ */
+struct FountainSimulationOptions
+{
+    /// Generated message length in bytes.
+    size_t messageLength = 100;
+    /// Maximum fragment length in bytes.
+    size_t maxFragmentLength = 100;
+    /// Number of simulated transfers.
+    size_t numTrials = 10000;
+    /// Probability that a part is lost.
+    double lossRate = 0;
+    /// Mean number of consecutive lost parts. Losses are independent when it is 1.
+    double meanBurstLength = 1;
+    /// Seed of the generated messages and of the loss channel.
+    uint32_t seed = 0;
+    /// Number of worker threads. All available cores are used when 0.
+    unsigned numThreads = 0;
+    /// A transfer fails if it is not complete after this multiple of the sequence length.
+    size_t maxPartsFactor = 100;
+};
+
+/**
+ *  \brief  Distribution of the number of parts needed to decode a message.
+ */
+struct FountainSimulationResult
+{
+    /// Number of pure parts of the message.
+    size_t seqLen = 0;
+    /// Number of transfers, indexed by the number of sent parts at completion.
+    std::vector<size_t> partsSent;
+    /// Number of transfers, indexed by the number of received parts at completion.
+    std::vector<size_t> partsReceived;
+    /// Number of transfers that did not complete.
+    size_t failures = 0;
+};
+
+/**
+ *  \brief  Simulates transfers of random messages through a lossy channel.
+ *
+ *  Each trial generates a message, sends the parts of a fountain encoder through a Bernoulli or
+ *  a Gilbert-Elliott burst loss channel and feeds the remaining parts into a fountain decoder
+ *  until it completes. The UR string and QR layers are skipped since they do not change which
+ *  parts arrive. Trials are distributed over threads and depend only on the seed and their
+ *  index, so the result is reproducible.
+ *
+ *  \param  options Simulation settings.
+ *  \returns    Distribution of parts to completion.
+ */
+FountainSimulationResult RunFountainSimulation(const FountainSimulationOptions& options);
+
+/**
+ *  \brief  Prints a summary to stderr and the distribution of sent and received parts as CSV.
+ *  \param  result  Simulation result.
+ *  \param  os  Output stream of the CSV table.
+ */
+void PrintFountainSimulation(const FountainSimulationResult& result, std::ostream& os);
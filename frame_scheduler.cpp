@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+
+FrameScheduler::FrameScheduler(const double fps)
+    : m_period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)))
+{
+}
+
+FrameScheduler::Clock::time_point FrameScheduler::NextDeadline() const
+{
+    if (m_displayTimes.empty())
+    {
+        return Clock::now();
+    }
+    return m_start + static_cast<Clock::rep>(m_displayTimes.size()) * m_period;
+}
+
+void FrameScheduler::FrameShown(const Clock::time_point displayTime)
+{
+    if (m_displayTimes.empty())
+    {
+        m_start = displayTime;
+    }
+    m_jitter.push_back(displayTime - NextDeadline());
+    m_displayTimes.push_back(displayTime);
+}
+
+const std::vector<FrameScheduler::Clock::time_point>& FrameScheduler::DisplayTimes() const
+{
+    return m_displayTimes;
+}
+
+void FrameScheduler::PrintReport(std::ostream& os) const
+{
+    if (m_displayTimes.size() < 2)
+    {
+        return;
+    }
+
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const auto elapsed = std::chrono::duration<double>(m_displayTimes.back() - m_displayTimes.front()).count();
+
+    // The first frame defines the schedule and has no jitter.
+    std::vector<double> jitter;
+    std::transform(m_jitter.begin() + 1, m_jitter.end(), std::back_inserter(jitter), [](const auto& d){ return std::abs(Milliseconds(d).count()); });
+    std::sort(jitter.begin(), jitter.end());
+    const auto percentile = [&jitter](const double p)
+    {
+        return jitter[std::min(jitter.size() - 1, static_cast<size_t>(p * jitter.size()))];
+    };
+
+    os << std::fixed << std::setprecision(3);
+    os << "Frames: " << m_displayTimes.size() << ", target FPS: " << 1.0 / std::chrono::duration<double>(m_period).count()
+        << ", achieved FPS: " << (m_displayTimes.size() - 1) / elapsed << std::endl;
+    os << "Jitter [ms]: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max " << jitter.back() << std::endl;
+
+    const double BOUNDS[] = {0.5, 1, 2, 4, 8, 16, 32};
+    double lower = 0;
+    for (const auto upper : BOUNDS)
+    {
+        const auto count = std::lower_bound(jitter.begin(), jitter.end(), upper) - std::lower_bound(jitter.begin(), jitter.end(), lower);
+        os << "  " << std::setw(6) << lower << " - " << std::setw(6) << upper << ": " << count << std::endl;
+        lower = upper;
+    }
+    os << "  " << std::setw(6) << lower << " -       : " << jitter.end() - std::lower_bound(jitter.begin(), jitter.end(), lower) << std::endl;
+    os << std::defaultfloat;
+}
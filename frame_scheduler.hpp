@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+/**
+ *  \brief  Computes absolute display deadlines of frames and records when they were shown.
+ *
+ *  The deadline of the n-th frame is start + n * period, so delays of individual frames do not
+ *  accumulate. The difference between the display time and the deadline of each frame is kept to
+ *  report the jitter of the presentation.
+ */
+class FrameScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     *  \brief  Creates a scheduler.
+     *  \param  fps Number of frames per second. Fractional values are allowed.
+     */
+    explicit FrameScheduler(const double fps);
+
+    /**
+     *  \brief  Returns the deadline of the next frame. The first frame is due immediately.
+     */
+    Clock::time_point NextDeadline() const;
+
+    /**
+     *  \brief  Records that the next frame was shown and advances to the following deadline.
+     *  \param  displayTime Time at which the frame was shown.
+     */
+    void FrameShown(const Clock::time_point displayTime);
+
+    /**
+     *  \brief  Returns the display times of all shown frames.
+     */
+    const std::vector<Clock::time_point>& DisplayTimes() const;
+
+    /**
+     *  \brief  Prints the achieved frame rate and a histogram of the display jitter.
+     *  \param  os  Output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+private:
+    const Clock::duration m_period;
+    Clock::time_point m_start;
+    std::vector<Clock::time_point> m_displayTimes;
+    std::vector<Clock::duration> m_jitter;
+};
@@ -0,0 +1,247 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_stream.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "pipeline_stats.hpp"
+#include "qr_encoder.hpp"
+
+/**
+ *  \brief  Creates the lifehash image of a stream and accounts for it in the pipeline statistics.
+ */
+static cv::Mat CreateStreamLifeHashImage(const ur::UR& message, const int size)
+{
+    StageTimer timer(Stage::LifeHash);
+    return CreateLifeHashImage(message, size);
+}
+
+ImagePool::ImagePool(const cv::Size size, const int type)
+    : m_size(size)
+    , m_type(type)
+    , m_freeList(std::make_shared<FreeList>())
+{
+}
+
+void ImagePool::Acquire(Frame& frame)
+{
+    std::unique_ptr<cv::Mat> image;
+    {
+        std::lock_guard<std::mutex> lock(m_freeList->mutex);
+        if (!m_freeList->images.empty())
+        {
+            image = std::move(m_freeList->images.back());
+            m_freeList->images.pop_back();
+        }
+    }
+    if (!image)
+    {
+        image = std::make_unique<cv::Mat>(m_size, m_type);
+    }
+    frame.image = *image;
+    const std::weak_ptr<FreeList> freeList = m_freeList;
+    frame.lease = std::shared_ptr<const void>(image.release(), [freeList](cv::Mat* released)
+    {
+        std::unique_ptr<cv::Mat> image(released);
+        if (const auto list = freeList.lock())
+        {
+            std::lock_guard<std::mutex> lock(list->mutex);
+            list->images.push_back(std::move(image));
+        }
+    });
+}
+
+UrSource::UrSource(const ur::UR& message, const FrameStreamOptions& options)
+    : m_message(message)
+    , m_options(options)
+{
+    if (m_options.isSinglePart)
+    {
+        m_singlePart = GenerateSinglePartUr(m_message);
+    }
+    else
+    {
+        m_encoder = std::make_unique<ur::UREncoder>(m_message, m_options.maxFragmentLength);
+    }
+}
+
+size_t UrSource::CycleLength() const
+{
+    return m_encoder ? m_encoder->seq_len() + m_options.numExtraParts : 1;
+}
+
+std::string UrSource::Next()
+{
+    if (!m_encoder)
+    {
+        return m_singlePart;
+    }
+    if (!m_options.isFountain && m_position == CycleLength())
+    {
+        m_encoder = std::make_unique<ur::UREncoder>(m_message, m_options.maxFragmentLength);
+        m_position = 0;
+    }
+    ++m_position;
+    return m_encoder->next_part();
+}
+
+int RenderFrame(const cv::Mat& lifeHashImage, const FrameStreamOptions& options, Frame& frame)
+{
+    QrCodePtr libqrencodeQur;
+    QRcode qur;
+    {
+        StageTimer timer(Stage::QrEncoding);
+        if (options.qr.backend == QrEncoderBackend::InTree)
+        {
+            if (options.qr.isMicro)
+            {
+                throw std::invalid_argument("The in-tree QR encoder does not support Micro QR");
+            }
+            thread_local QrEncoder encoder;
+            qur = encoder.Encode(frame.ur, options.qr);
+        }
+        else
+        {
+            if (options.qr.maskPolicy != QrMaskPolicy::Full)
+            {
+                throw std::invalid_argument("libqrencode supports the full mask policy only");
+            }
+            libqrencodeQur = EncodeQr(frame.ur, options.qr);
+            qur = *libqrencodeQur;
+        }
+    }
+    cv::Mat qurImage;
+    {
+        StageTimer timer(Stage::Composition);
+        qurImage = PrepareFrame(lifeHashImage, options.qrSize, frame.image);
+    }
+    {
+        StageTimer timer(Stage::Rasterization);
+        RasterizeQr(&qur, options.qrSize, qurImage);
+    }
+    if (options.degradation.IsEnabled())
+    {
+        StageTimer timer(Stage::Degradation);
+        DegradeFrame(frame.image, options.degradation, frame.index);
+    }
+    return qur.version;
+}
+
+FrameStream::FrameStream(const ur::UR& message, const FrameStreamOptions& options)
+    : m_options(options)
+    , m_urs(message, options)
+    , m_cycleLength(m_urs.CycleLength())
+    , m_lifeHashImage(CreateStreamLifeHashImage(message, options.lifeHashImageSize))
+    , m_queue(options.lookahead)
+    , m_images(GetFrameSize(m_lifeHashImage, options.qrSize), CV_8UC3)
+{
+    m_producer = std::thread(&FrameStream::Produce, this);
+}
+
+FrameStream::~FrameStream()
+{
+    m_stop = true;
+    m_queue.Close();
+    m_producer.join();
+}
+
+size_t FrameStream::CycleLength() const
+{
+    return m_cycleLength;
+}
+
+bool FrameStream::Next(Frame& frame)
+{
+    if (m_queue.Pop(frame))
+    {
+        return true;
+    }
+    if (m_error)
+    {
+        std::rethrow_exception(m_error);
+    }
+    return false;
+}
+
+void FrameStream::Produce()
+{
+    try
+    {
+        const size_t batchSize = std::max<size_t>(1, m_options.lookahead);
+        std::vector<Frame> batch;
+        size_t index = 0;
+        while (!m_stop && (m_options.numFrames == 0 || index < m_options.numFrames))
+        {
+            // UR parts depend on the encoder state, so they are generated sequentially. The QR
+            // codes and frames of a batch are independent and rendered in parallel.
+            const size_t count = m_options.numFrames == 0 ? batchSize : std::min(batchSize, m_options.numFrames - index);
+            batch.resize(count);
+            {
+                StageTimer timer(Stage::UrEncoding);
+                for (auto& frame : batch)
+                {
+                    frame.index = index++;
+                    frame.ur = m_urs.Next();
+                    m_images.Acquire(frame);
+                }
+            }
+
+            // Exceptions must not leave the parallel body, so they are kept and rethrown after it.
+            std::vector<std::exception_ptr> errors(count);
+            cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range& range)
+            {
+                for (int i = range.start; i < range.end; ++i)
+                {
+                    try
+                    {
+                        RenderFrame(m_lifeHashImage, m_options, batch[i]);
+                        RecordFrameRendered();
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            }, static_cast<double>(count));
+            for (const auto& error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            for (auto& frame : batch)
+            {
+                if (!m_queue.Push(std::move(frame)))
+                {
+                    return;
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        m_error = std::current_exception();
+    }
+    m_queue.Close();
+}
@@ -0,0 +1,221 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+#include <bc-ur/ur-encoder.hpp>
+
+#include "bounded_queue.hpp"
+#include "degrade.hpp"
+#include "qur.hpp"
+
+/**
+ *  \brief  A composed frame together with the UR string it shows.
+ */
+struct Frame
+{
+    /// Position of the frame in the stream.
+    size_t index = 0;
+    /// UR encoded string shown by the frame.
+    std::string ur;
+    /// Composed BGR image.
+    cv::Mat image;
+    /// Hands a pooled image back to its ImagePool when the last copy of the frame is released;
+    /// empty if the image is not pooled. Code keeping the image beyond the frame keeps the frame.
+    std::shared_ptr<const void> lease;
+};
+
+/**
+ *  \brief  Image buffers of one size and type, reused once the frames showing them are released.
+ *
+ *  Every acquired image comes with a lease whose deleter puts the buffer back on a free list, so
+ *  buffers return explicitly when the consumer drops the frame, on whatever thread that happens.
+ *  Leases may outlive the pool; their buffers are then freed instead of returned.
+ */
+class ImagePool
+{
+public:
+    /**
+     *  \brief  Creates an empty pool.
+     *  \param  size    Size of the images.
+     *  \param  type    OpenCV type of the images.
+     */
+    ImagePool(cv::Size size, int type);
+
+    /**
+     *  \brief  Takes a released buffer from the pool, or allocates a new one if there is none.
+     *  \param  frame   Frame whose image and lease are replaced. The contents of the image are
+     *                  undefined.
+     */
+    void Acquire(Frame& frame);
+
+private:
+    struct FreeList
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<cv::Mat>> images;
+    };
+
+    const cv::Size m_size;
+    const int m_type;
+    std::shared_ptr<FreeList> m_freeList;
+};
+
+/**
+ *  \brief  Settings of a FrameStream.
+ */
+struct FrameStreamOptions
+{
+    /// Generate single part UR flag.
+    bool isSinglePart = true;
+    /// Maximum fragment length for multi-part UR in bytes.
+    size_t maxFragmentLength = 100;
+    /// Number of extra parts for multi-part UR.
+    size_t numExtraParts = 0;
+    /// Keep generating new fountain parts instead of repeating the multi-part UR sequence.
+    bool isFountain = false;
+    /// QR encoder settings.
+    QrOptions qr;
+    /// Size of generated QR image in pixels
+    int qrSize = 256;
+    /// Size of generated Lifehash image in pixels.
+    int lifeHashImageSize = 128;
+    /// Degradations applied to the composed frames.
+    DegradationOptions degradation;
+    /// Number of frames to produce. The UR sequence is repeated until then; unlimited when 0.
+    size_t numFrames = 0;
+    /// Maximum number of frames rendered ahead of the consumer.
+    size_t lookahead = 16;
+};
+
+/**
+ *  \brief  Produces the UR strings of a message one at a time.
+ *
+ *  A multi-part UR sequence consists of the pure parts followed by the extra parts. When the
+ *  sequence is exhausted, the encoder is restarted, so the same strings are repeated. In fountain
+ *  mode the encoder is never restarted and every string is a new part.
+ */
+class UrSource
+{
+public:
+    /**
+     *  \brief  Creates a source of UR strings.
+     *  \param  message A message that will be encoded.
+     *  \param  options Stream settings.
+     */
+    UrSource(const ur::UR& message, const FrameStreamOptions& options);
+
+    /**
+     *  \brief  Returns the number of UR strings before the sequence repeats.
+     *
+     *  A fountain sequence never repeats; the length of the finite sequence is returned.
+     */
+    size_t CycleLength() const;
+
+    /**
+     *  \brief  Returns the next UR string.
+     */
+    std::string Next();
+
+private:
+    const ur::UR m_message;
+    const FrameStreamOptions m_options;
+    std::string m_singlePart;
+    std::unique_ptr<ur::UREncoder> m_encoder;
+    size_t m_position = 0;
+};
+
+/**
+ *  \brief  Renders the frame of a UR string.
+ *
+ *  The QR code is encoded, composed with the lifehash image and degraded as set in the options.
+ *
+ *  \param  lifeHashImage   Lifehash image of the message.
+ *  \param  options Stream settings.
+ *  \param  frame   Frame whose index and UR string are set. Its image is overwritten in place if
+ *                  it has the frame size, otherwise replaced.
+ *  \returns    QR version of the frame.
+ */
+int RenderFrame(const cv::Mat& lifeHashImage, const FrameStreamOptions& options, Frame& frame);
+
+/**
+ *  \brief  Renders frames of a UR sequence on demand.
+ *
+ *  A background thread pulls UR strings from a UrSource, encodes and composes them in parallel
+ *  batches and hands them over through a bounded queue. At most twice the lookahead of frames
+ *  exists at any time, independently of the message length. The frame images are taken from an
+ *  ImagePool, so in a steady state no frame is allocated.
+ */
+class FrameStream
+{
+public:
+    /**
+     *  \brief  Starts rendering frames of a message.
+     *  \param  message A message that will be encoded.
+     *  \param  options Stream settings.
+     */
+    FrameStream(const ur::UR& message, const FrameStreamOptions& options);
+
+    /**
+     *  \brief  Stops rendering and waits for the background thread.
+     */
+    ~FrameStream();
+
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    /**
+     *  \brief  Returns the number of UR strings before the sequence repeats.
+     */
+    size_t CycleLength() const;
+
+    /**
+     *  \brief  Waits for the next frame.
+     *
+     *  Errors raised while rendering are rethrown here.
+     *
+     *  \param  frame   The next frame.
+     *  \returns    False if the stream has ended.
+     */
+    bool Next(Frame& frame);
+
+private:
+    void Produce();
+
+    const FrameStreamOptions m_options;
+    UrSource m_urs;
+    const size_t m_cycleLength;
+    const cv::Mat m_lifeHashImage;
+    BoundedQueue<Frame> m_queue;
+    ImagePool m_images;
+    std::atomic<bool> m_stop{false};
+    std::exception_ptr m_error;
+    std::thread m_producer;
+};
@@ -0,0 +1,165 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "loopback.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+#include <opencv2/objdetect.hpp>
+
+#include <bc-ur/ur-decoder.hpp>
+
+void PrintLoopbackResult(const LoopbackResult& result, std::ostream& os)
+{
+    os << "Loopback: " << (result.isComplete ? (result.isMatch ? "message recovered" : "decoded message does not match") : "message not recovered")
+        << ", frames processed: " << result.framesProcessed
+        << ", frames decoded: " << result.framesDecoded;
+    if (result.isComplete)
+    {
+        os << ", frames to complete: " << result.framesToComplete;
+    }
+    os << std::endl;
+
+    if (result.decodeTimes.empty())
+    {
+        return;
+    }
+    std::vector<double> times;
+    std::transform(result.decodeTimes.begin(), result.decodeTimes.end(), std::back_inserter(times), [](const auto& t){ return std::chrono::duration<double, std::milli>(t).count(); });
+    std::sort(times.begin(), times.end());
+    const auto percentile = [&times](const double p)
+    {
+        return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))];
+    };
+    os << std::fixed << std::setprecision(3)
+        << "Decode time per frame [ms]: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max " << times.back()
+        << std::defaultfloat << std::endl;
+}
+
+LoopbackVerifier::LoopbackVerifier(const ur::UR& message, const size_t capacity)
+    : m_message(message)
+    , m_batchSize(std::max<size_t>(1, capacity))
+    , m_queue(capacity)
+{
+    m_thread = std::thread(&LoopbackVerifier::Decode, this);
+}
+
+LoopbackVerifier::~LoopbackVerifier()
+{
+    m_queue.Close();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void LoopbackVerifier::Submit(const Frame& frame)
+{
+    if (!m_isComplete)
+    {
+        m_queue.Push(frame);
+    }
+}
+
+bool LoopbackVerifier::IsComplete() const
+{
+    return m_isComplete;
+}
+
+LoopbackResult LoopbackVerifier::Finish()
+{
+    m_queue.Close();
+    m_thread.join();
+    if (m_error)
+    {
+        std::rethrow_exception(m_error);
+    }
+    return m_result;
+}
+
+void LoopbackVerifier::Decode()
+{
+    try
+    {
+        ur::URDecoder decoder;
+        std::vector<Frame> batch;
+        std::vector<std::string> contents;
+        std::vector<std::chrono::nanoseconds> times;
+        Frame frame;
+        while (m_queue.Pop(frame))
+        {
+            // Wait for one frame, then take whatever else is already queued as a batch.
+            batch.clear();
+            batch.push_back(std::move(frame));
+            while (batch.size() < m_batchSize && m_queue.TryPop(frame))
+            {
+                batch.push_back(std::move(frame));
+            }
+            if (m_isComplete)
+            {
+                continue;
+            }
+
+            contents.assign(batch.size(), std::string());
+            times.assign(batch.size(), std::chrono::nanoseconds());
+            cv::parallel_for_(cv::Range(0, static_cast<int>(batch.size())), [&](const cv::Range& range)
+            {
+                cv::QRCodeDetector detector;
+                for (int i = range.start; i < range.end; ++i)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    cv::Mat points;
+                    contents[i] = detector.detectAndDecode(batch[i].image, points);
+                    times[i] = std::chrono::steady_clock::now() - start;
+                }
+            }, static_cast<double>(batch.size()));
+
+            for (size_t i = 0; i < batch.size() && !m_isComplete; ++i)
+            {
+                ++m_result.framesProcessed;
+                if (m_result.decodeTimes.size() < LOOPBACK_MAX_DECODE_TIMES)
+                {
+                    m_result.decodeTimes.push_back(times[i]);
+                }
+                if (contents[i].empty())
+                {
+                    continue;
+                }
+                ++m_result.framesDecoded;
+                decoder.receive_part(contents[i]);
+                if (decoder.is_complete())
+                {
+                    m_result.isComplete = true;
+                    m_result.framesToComplete = m_result.framesProcessed;
+                    m_result.isMatch = decoder.is_success()
+                        && decoder.result_ur().type() == m_message.type()
+                        && decoder.result_ur().cbor() == m_message.cbor();
+                    m_isComplete = true;
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        m_error = std::current_exception();
+        m_isComplete = true;
+        m_queue.Close();
+    }
+}
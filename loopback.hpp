@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+
+#include "bounded_queue.hpp"
+#include "frame_stream.hpp"
+
+/// Number of decode times kept for the percentiles, so that runs which never complete stay bounded.
+constexpr size_t LOOPBACK_MAX_DECODE_TIMES = 1 << 16;
+
+/**
+ *  \brief  Outcome of a loopback verification.
+ */
+struct LoopbackResult
+{
+    /// Number of frames passed to the QR detector.
+    size_t framesProcessed = 0;
+    /// Number of frames in which a QR code was detected and decoded.
+    size_t framesDecoded = 0;
+    /// Number of frames processed until the UR decoder completed, or 0.
+    size_t framesToComplete = 0;
+    /// The UR decoder received enough parts.
+    bool isComplete = false;
+    /// The decoded message equals the original one.
+    bool isMatch = false;
+    /// Detection and decoding time of the processed frames, at most the first LOOPBACK_MAX_DECODE_TIMES.
+    std::vector<std::chrono::nanoseconds> decodeTimes;
+};
+
+/**
+ *  \brief  Prints a loopback result together with decode time percentiles.
+ *  \param  result  Loopback result.
+ *  \param  os  Output stream.
+ */
+void PrintLoopbackResult(const LoopbackResult& result, std::ostream& os);
+
+/**
+ *  \brief  Decodes rendered frames with cv::QRCodeDetector and ur::URDecoder on a background thread.
+ *
+ *  Frames are detected in parallel batches and their contents are passed to the UR decoder in the
+ *  order of submission. Once the decoder completes, further frames are ignored.
+ */
+class LoopbackVerifier
+{
+public:
+    /**
+     *  \brief  Starts the verification thread.
+     *  \param  message The original message.
+     *  \param  capacity    Maximum number of frames waiting for decoding.
+     */
+    LoopbackVerifier(const ur::UR& message, const size_t capacity);
+
+    /**
+     *  \brief  Stops the verification thread.
+     */
+    ~LoopbackVerifier();
+
+    LoopbackVerifier(const LoopbackVerifier&) = delete;
+    LoopbackVerifier& operator=(const LoopbackVerifier&) = delete;
+
+    /**
+     *  \brief  Queues a frame for decoding, waiting while the queue is full.
+     *
+     *  The frame shares the image buffer with the caller, which must not modify it afterwards.
+     *
+     *  \param  frame   Rendered frame.
+     */
+    void Submit(const Frame& frame);
+
+    /**
+     *  \brief  Returns true once the UR decoder has completed.
+     */
+    bool IsComplete() const;
+
+    /**
+     *  \brief  Waits until all submitted frames are processed and returns the result.
+     *
+     *  Errors raised while decoding are rethrown here.
+     */
+    LoopbackResult Finish();
+
+private:
+    void Decode();
+
+    const ur::UR m_message;
+    const size_t m_batchSize;
+    BoundedQueue<Frame> m_queue;
+    std::atomic<bool> m_isComplete{false};
+    LoopbackResult m_result;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+};
@@ -18,21 +18,46 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
 #include <iostream>
 #include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include <iterator>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/opencv.hpp>
-
-#include <qrencode.h>
+#include <opencv2/videoio.hpp>
 
 #include <bc-ur/bc-ur.hpp>
-#include <bc-ur/ur-encoder.hpp>
 
-#include <lifehash.hpp>
+#include "camera_sim.hpp"
+#include "corpus.hpp"
+#include "frame_scheduler.hpp"
+#include "fountain_sim.hpp"
+#include "frame_stream.hpp"
+#include "loopback.hpp"
+#include "pipeline_stats.hpp"
+#include "qr_capacity.hpp"
+#include "qr_encoder.hpp"
+#include "qur.hpp"
+#include "raw_output.hpp"
+#include "shm_ring.hpp"
+#include "sweep.hpp"
+#include "tiled_stream.hpp"
 
 /**
  *  \brief  Holds command line arguments.
@@ -47,12 +72,86 @@ struct CommandLineArguments
     size_t maxFragmentLength = 100;
     /// Number of extra parts for multi-part UR.
     size_t numExtraParts = 0;
+    /// Keep generating new fountain parts instead of repeating the multi-part UR sequence.
+    bool isFountain = false;
+    /// QR encoder settings.
+    QrOptions qr;
+    /// QR version whose capacity determines the fragment length, or 0.
+    int qrVersion = 0;
+    /// Maximum QR width in modules that determines the fragment length, or 0.
+    int maxModules = 0;
+    /// Print the QR versions reached by the UR strings and exit.
+    bool printQrReport = false;
     /// Size of generated QR image in pixels
     int qrSize = 256;
+    /// Degradations applied to the composed frames.
+    DegradationOptions degradation;
+    /// Number of independent messages tiled into each frame.
+    size_t numStreams = 1;
+    /// Maximum fragment length of each tiled stream. The -f value is used when empty.
+    std::vector<size_t> streamFragmentLengths;
+    /// Number of parts each tiled stream skips at the start.
+    std::vector<size_t> streamPhases;
+    /// Film the displayed frames with a simulated camera.
+    bool simulateCamera = false;
+    /// Parameters of the simulated camera.
+    CameraOptions camera;
     /// Size of generated Lifehash image in pixels.
     int lifeHashImageSize = 128;
     /// Number of FPS for multi-part QR code visualization.
-    int fps = 4;
+    double fps = 4;
+    /// Number of worker threads for parallel stages. All available cores are used when 0.
+    int numThreads = 0;
+    /// Output directory for headless rendering. Frames are shown in a window when empty.
+    std::string outDir;
+    /// Output video file. Frames are shown in a window when empty.
+    std::string videoPath;
+    /// FourCC of the video codec.
+    std::string videoCodec = "FFV1";
+    /// Write frames to stdout as a raw video stream.
+    bool writeStdout = false;
+    /// Pixel format of the raw video stream.
+    RawFormat rawFormat = RawFormat::Y4m;
+    /// Name of the shared-memory frame ring. No ring is written when empty.
+    std::string shmName;
+    /// Number of slots of the shared-memory frame ring.
+    size_t numShmSlots = 8;
+    /// Pace the raw video stream or the frame ring to the -t rate instead of writing as fast as possible.
+    bool pace = false;
+    /// Number of repetitions of the UR sequence in the video or in the loopback verification.
+    size_t numLoops = 1;
+    /// Decode the rendered frames and check that the message is recovered.
+    bool verify = false;
+    /// Number of simulated transfers of the fountain code. No simulation is run when 0.
+    size_t numSimulationTrials = 0;
+    /// Probability that a part is lost in the simulation.
+    double lossRate = 0;
+    /// Mean number of consecutive lost parts in the simulation.
+    double meanBurstLength = 1;
+    /// Output file of the pipeline statistics. No statistics are written when empty.
+    std::string statsPath;
+    /// Output file of the parameter sweep CSV, '-' for stdout. No sweep is run when empty.
+    std::string sweepPath;
+    /// Message lengths of the sweep. The -l value is used when empty.
+    std::vector<double> sweepMessageLengths;
+    /// Fragment lengths of the sweep. The -f value is used when empty.
+    std::vector<double> sweepFragmentLengths;
+    /// QR sizes of the sweep. The -s value is used when empty.
+    std::vector<double> sweepQrSizes;
+    /// QR error correction levels of the sweep. The --ec-level value is used when empty.
+    std::vector<QRecLevel> sweepEcLevels;
+    /// Display frame rates of the sweep. The -t value is used when empty.
+    std::vector<double> sweepFpss;
+    /// Mask policies of the sweep. The --qr-mask value is used when empty.
+    std::vector<std::string> sweepMaskPolicies;
+    /// Number of transfers per sweep configuration.
+    size_t numSweepTrials = 1;
+    /// Seed of the generated message. A random one is chosen and printed when not given.
+    uint32_t seed = std::random_device()();
+    /// Output file of the test-vector corpus. No corpus is written when empty.
+    std::string corpusPath;
+    /// Number of cases in the test-vector corpus.
+    size_t numCorpusCases = 1000;
 };
 
 /**
@@ -86,6 +185,10 @@ static CommandLineArguments ParseCommandLineArguments(const int argc, char** arg
             assert(i+1 <= argc && "Value expected.");
             result.numExtraParts = stoul(std::string(argv[++i]));
         }
+        else if (arg == "--fountain")
+        {
+            result.isFountain = true;
+        }
         else if (arg == "-h")
         {
             std::cerr << "Usage: ./qurtest [OPTION]..." << std::endl;
@@ -94,8 +197,47 @@ static CommandLineArguments ParseCommandLineArguments(const int argc, char** arg
             std::cerr << "\t-l <value>\tByte length of the generated data (default=100)." << std::endl;
             std::cerr << "\t-f <value>\tByte length of a single data fragment in a multi-part UR (default=100)." << std::endl;
             std::cerr << "\t-e <value>\tNumber of extra parts in a multi-part UR (default=0)." << std::endl;
+            std::cerr << "\t--fountain\tShow a new fountain part in every frame instead of repeating the multi-part UR (default=false)." << std::endl;
             std::cerr << "\t-s <value>\tSize of the generated QR image (default=256px)." << std::endl;
-            std::cerr << "\t-t <value>\tNumber of FPS for multi-part QUR visualization.  (default=4)." << std::endl;
+            std::cerr << "\t--qr-mode <byte|alnum>\tQR encoding mode. The alnum mode encodes the uppercased UR (default=byte)." << std::endl;
+            std::cerr << "\t--qr-encoder <libqrencode|intree>\tQR encoder implementation (default=libqrencode)." << std::endl;
+            std::cerr << "\t--qr-mask <full|fast|0-7>\tMask policy of the in-tree encoder: score all masks, score them by rows only, or a fixed mask (default=full)." << std::endl;
+            std::cerr << "\t--ec-level <L|M|Q|H>\tQR error correction level (default=L)." << std::endl;
+            std::cerr << "\t--micro\tEncode Micro QR codes. Only single part URs of messages up to 1 byte fit, in alnum mode. --qr-version selects M1 to M4 (default=false)." << std::endl;
+            std::cerr << "\t--qr-version <value>\tEncode every QR code in the given version, so all frames have the same module pitch, and set the fragment length to the largest one that fits it." << std::endl;
+            std::cerr << "\t--max-modules <value>\tSet the fragment length to the largest one that fits a QR code of at most the given width in modules." << std::endl;
+            std::cerr << "\t--qr-report\tPrint the QR version reached for each fragment length in both modes and exit." << std::endl;
+            std::cerr << "\t--degrade <spec>\tDegrade frames, e.g. rotation=5,perspective=0.05,glare=0.4,blur=1.5,motion=7,gamma=1.4,brightness=-20,noise=8,jpeg=40,seed=1." << std::endl;
+            std::cerr << "\t--streams <value>\tTile the frames of the given number of independent messages into one frame, message i uses seed + i (default=1)." << std::endl;
+            std::cerr << "\t--stream-f <values>\tComma separated fragment lengths of the tiled streams, repeated for further streams (default=-f)." << std::endl;
+            std::cerr << "\t--stream-phase <values>\tComma separated numbers of parts the tiled streams skip at the start (default=0)." << std::endl;
+            std::cerr << "\t--camera <spec>\tReplace the displayed frames by the captures of a simulated camera, e.g. fps=30,exposure=16,readout=20,drop=0.05,phase=0.5,seed=1." << std::endl;
+            std::cerr << "\t-t <value>\tNumber of FPS for multi-part QUR visualization, fractional values are allowed (default=4)." << std::endl;
+            std::cerr << "\t--verify\tDecode the rendered frames and check that the message is recovered. Without an output it runs headless." << std::endl;
+            std::cerr << "\t--simulate <value>\tSimulate the given number of transfers of a multi-part UR without imaging, print the distribution of parts to completion and exit." << std::endl;
+            std::cerr << "\t--loss <value>\tProbability that a part is lost in the simulation (default=0)." << std::endl;
+            std::cerr << "\t--burst <value>\tMean number of consecutive lost parts in the simulation, 1 for independent losses (default=1)." << std::endl;
+            std::cerr << "\t--stats <path>\tWrite stage timings and resource usage as JSON on exit, '-' for stdout." << std::endl;
+            std::cerr << "\t--sweep <path>\tRun every combination of the --sweep-* ranges with loopback decoding, write a CSV, '-' for stdout, and exit." << std::endl;
+            std::cerr << "\t--sweep-l <range>\tMessage lengths of the sweep, values and inclusive start:stop:step ranges, e.g. 1000:5000:1000,10000 (default=-l)." << std::endl;
+            std::cerr << "\t--sweep-f <range>\tFragment lengths of the sweep (default=-f)." << std::endl;
+            std::cerr << "\t--sweep-s <range>\tQR sizes of the sweep (default=-s)." << std::endl;
+            std::cerr << "\t--sweep-ec <levels>\tError correction levels of the sweep, e.g. LMQH (default=--ec-level)." << std::endl;
+            std::cerr << "\t--sweep-t <range>\tDisplay frame rates of the sweep, they matter with --camera (default=-t)." << std::endl;
+            std::cerr << "\t--sweep-mask <policies>\tComma separated mask policies of the sweep, runs all configurations with the in-tree encoder (default=--qr-mask)." << std::endl;
+            std::cerr << "\t--sweep-trials <value>\tNumber of transfers per configuration, each with its own message (default=1)." << std::endl;
+            std::cerr << "\t--seed <value>\tSeed of the generated message (default=random, printed to stderr)." << std::endl;
+            std::cerr << "\t--corpus <path>\tWrite a binary corpus of messages and their UR parts with lengths up to -l, -f and -e extra parts and exit." << std::endl;
+            std::cerr << "\t--corpus-cases <value>\tNumber of cases in the corpus, case i uses seed + i (default=1000)." << std::endl;
+            std::cerr << "\t-j <value>\tNumber of worker threads (default=0, all cores)." << std::endl;
+            std::cerr << "\t--out-dir <path>\tWrite frames and a manifest of UR strings to a directory instead of showing them." << std::endl;
+            std::cerr << "\t--video <path>\tWrite frames to a video file at the -t rate instead of showing them." << std::endl;
+            std::cerr << "\t--video-codec <ffv1|png|mjpg>\tVideo codec (default=ffv1)." << std::endl;
+            std::cerr << "\t--stdout <y4m|y4m-mono|gray|bgr>\tWrite frames to stdout as YUV4MPEG2 or headerless raw video instead of showing them." << std::endl;
+            std::cerr << "\t--shm <name>\tPublish frames into a POSIX shared-memory ring, e.g. /qurtest, read by qurtest_consumer, instead of showing them." << std::endl;
+            std::cerr << "\t--shm-slots <value>\tNumber of slots of the shared-memory ring (default=8)." << std::endl;
+            std::cerr << "\t--pace\tWrite frames to stdout or to the shared-memory ring at the -t rate instead of as fast as possible." << std::endl;
+            std::cerr << "\t--loops <value>\tNumber of repetitions of the UR sequence in the video or in the loopback verification (default=1)." << std::endl;
             exit(0);
         }
         else if (arg == "-s")
@@ -103,10 +245,235 @@ static CommandLineArguments ParseCommandLineArguments(const int argc, char** arg
             assert(i+1 <= argc && "Value expected.");
             result.qrSize = stoul(std::string(argv[++i]));
         }
+        else if (arg == "--qr-mode")
+        {
+            assert(i+1 < argc && "Value expected.");
+            const auto mode = std::string(argv[++i]);
+            assert((mode == "byte" || mode == "alnum") && "Unknown QR encoding mode");
+            result.qr.mode = mode == "alnum" ? QrEncodingMode::Alphanumeric : QrEncodingMode::Byte;
+        }
+        else if (arg == "--qr-encoder")
+        {
+            assert(i+1 < argc && "Value expected.");
+            const auto encoder = std::string(argv[++i]);
+            assert((encoder == "libqrencode" || encoder == "intree") && "Unknown QR encoder");
+            result.qr.backend = encoder == "intree" ? QrEncoderBackend::InTree : QrEncoderBackend::Libqrencode;
+        }
+        else if (arg == "--micro")
+        {
+            result.qr.isMicro = true;
+        }
+        else if (arg == "--qr-mask")
+        {
+            assert(i+1 < argc && "Value expected.");
+            ParseQrMaskPolicy(argv[++i], result.qr);
+        }
+        else if (arg == "--ec-level")
+        {
+            assert(i+1 < argc && "Value expected.");
+            const auto level = std::string(argv[++i]);
+            const auto levels = std::string("LMQH");
+            assert(level.size() == 1 && levels.find(level[0]) != std::string::npos && "Unknown error correction level");
+            result.qr.ecLevel = static_cast<QRecLevel>(QR_ECLEVEL_L + levels.find(level[0]));
+        }
+        else if (arg == "--qr-version")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.qrVersion = stoul(std::string(argv[++i]));
+            assert(result.qrVersion >= QR_MIN_VERSION && result.qrVersion <= QR_MAX_VERSION && "Invalid QR version");
+            result.qr.version = result.qrVersion;
+        }
+        else if (arg == "--max-modules")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.maxModules = stoul(std::string(argv[++i]));
+            assert(GetQrVersionForWidth(result.maxModules) >= QR_MIN_VERSION && "No QR version fits the given width");
+        }
+        else if (arg == "--qr-report")
+        {
+            result.printQrReport = true;
+        }
+        else if (arg == "--degrade")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.degradation = ParseDegradationOptions(argv[++i]);
+        }
+        else if (arg == "--streams")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numStreams = stoul(std::string(argv[++i]));
+            assert(result.numStreams > 0 && "At least one stream expected");
+        }
+        else if (arg == "--stream-f")
+        {
+            assert(i+1 < argc && "Value expected.");
+            for (const auto value : ParseSweepRange(argv[++i]))
+            {
+                result.streamFragmentLengths.push_back(static_cast<size_t>(value));
+            }
+        }
+        else if (arg == "--stream-phase")
+        {
+            assert(i+1 < argc && "Value expected.");
+            for (const auto value : ParseSweepRange(argv[++i]))
+            {
+                result.streamPhases.push_back(static_cast<size_t>(value));
+            }
+        }
+        else if (arg == "--camera")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.simulateCamera = true;
+            result.camera = ParseCameraOptions(argv[++i]);
+        }
         else if (arg == "-t")
         {
             assert(i+1 <= argc && "Value expected.");
-            result.fps = stoul(std::string(argv[++i]));
+            result.fps = stod(std::string(argv[++i]));
+            assert(result.fps > 0 && "FPS must be positive");
+        }
+        else if (arg == "--verify")
+        {
+            result.verify = true;
+        }
+        else if (arg == "--simulate")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numSimulationTrials = stoul(std::string(argv[++i]));
+        }
+        else if (arg == "--loss")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.lossRate = stod(std::string(argv[++i]));
+            assert(result.lossRate >= 0 && result.lossRate <= 1 && "Loss rate must be between 0 and 1");
+        }
+        else if (arg == "--burst")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.meanBurstLength = stod(std::string(argv[++i]));
+            assert(result.meanBurstLength >= 1 && "Mean burst length must be at least 1");
+        }
+        else if (arg == "--stats")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.statsPath = argv[++i];
+        }
+        else if (arg == "--sweep")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.sweepPath = argv[++i];
+        }
+        else if (arg == "--sweep-l")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.sweepMessageLengths = ParseSweepRange(argv[++i]);
+        }
+        else if (arg == "--sweep-f")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.sweepFragmentLengths = ParseSweepRange(argv[++i]);
+        }
+        else if (arg == "--sweep-s")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.sweepQrSizes = ParseSweepRange(argv[++i]);
+        }
+        else if (arg == "--sweep-ec")
+        {
+            assert(i+1 < argc && "Value expected.");
+            const auto levels = std::string("LMQH");
+            for (const char level : std::string(argv[++i]))
+            {
+                assert(levels.find(level) != std::string::npos && "Unknown error correction level");
+                result.sweepEcLevels.push_back(static_cast<QRecLevel>(QR_ECLEVEL_L + levels.find(level)));
+            }
+        }
+        else if (arg == "--sweep-t")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.sweepFpss = ParseSweepRange(argv[++i]);
+        }
+        else if (arg == "--sweep-mask")
+        {
+            assert(i+1 < argc && "Value expected.");
+            std::istringstream policies(argv[++i]);
+            std::string policy;
+            while (std::getline(policies, policy, ','))
+            {
+                QrOptions options;
+                ParseQrMaskPolicy(policy, options);
+                result.sweepMaskPolicies.push_back(policy);
+            }
+        }
+        else if (arg == "--sweep-trials")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numSweepTrials = stoul(std::string(argv[++i]));
+            assert(result.numSweepTrials > 0 && "At least one trial expected");
+        }
+        else if (arg == "--seed")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.seed = static_cast<uint32_t>(stoul(std::string(argv[++i])));
+        }
+        else if (arg == "--corpus")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.corpusPath = argv[++i];
+        }
+        else if (arg == "--corpus-cases")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numCorpusCases = stoul(std::string(argv[++i]));
+        }
+        else if (arg == "-j")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numThreads = stoul(std::string(argv[++i]));
+        }
+        else if (arg == "--out-dir")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.outDir = argv[++i];
+        }
+        else if (arg == "--video")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.videoPath = argv[++i];
+        }
+        else if (arg == "--video-codec")
+        {
+            assert(i+1 < argc && "Value expected.");
+            const auto codec = std::string(argv[++i]);
+            assert((codec == "ffv1" || codec == "png" || codec == "mjpg") && "Unknown video codec");
+            result.videoCodec = codec == "png" ? "PNG " : (codec == "mjpg" ? "MJPG" : "FFV1");
+        }
+        else if (arg == "--stdout")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.writeStdout = true;
+            result.rawFormat = ParseRawFormat(argv[++i]);
+        }
+        else if (arg == "--shm")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.shmName = argv[++i];
+        }
+        else if (arg == "--shm-slots")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numShmSlots = stoul(std::string(argv[++i]));
+            assert(result.numShmSlots > 0 && "At least one slot expected");
+        }
+        else if (arg == "--pace")
+        {
+            result.pace = true;
+        }
+        else if (arg == "--loops")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.numLoops = stoul(std::string(argv[++i]));
+            assert(result.numLoops > 0 && "At least one loop expected");
         }
         else
         {
@@ -114,186 +481,655 @@ static CommandLineArguments ParseCommandLineArguments(const int argc, char** arg
         }
     }
     
-    const size_t MAX_LENGTH = 2956 / 2 - 13;
+    assert(!(result.numStreams > 1 && result.verify) && "Loopback verification decodes a single stream");
+    assert(!(result.writeStdout && (result.statsPath == "-" || result.sweepPath == "-")) && "stdout is taken by the frames");
+    assert(!(result.qr.maskPolicy != QrMaskPolicy::Full && result.qr.backend != QrEncoderBackend::InTree) && "Mask policies need --qr-encoder intree");
+
+    // OpenCV detects standard QR codes only and the in-tree encoder does not implement Micro QR.
+    assert(!(result.qr.isMicro && (result.verify || !result.sweepPath.empty())) && "Micro QR codes cannot be decoded");
+    assert(!(result.qr.isMicro && result.qr.backend != QrEncoderBackend::Libqrencode) && "Micro QR needs --qr-encoder libqrencode");
+    assert(!(result.qr.isMicro && (!result.isSinglePart || result.maxModules > 0 || result.qrVersion > QR_MICRO_MAX_VERSION)) && "Micro QR holds single part URs in versions M1 to M4");
+
+    // The corpus is always multi-part and never rendered, so the QR capacity does not limit it.
+    if (!result.corpusPath.empty())
+    {
+        return result;
+    }
+
+    // The fountain simulation neither encodes nor renders QR codes, only the UR encoder limits it.
+    if (result.numSimulationTrials > 0)
+    {
+        assert(result.messageLength >= GetMinMultiPartMessageLength() && "Message too short for a multi-part UR");
+        assert(result.maxFragmentLength >= UR_MIN_FRAGMENT_LENGTH && "Fragment too short");
+        assert(result.messageLength >= result.maxFragmentLength && "Fragment too long");
+        return result;
+    }
+
+    int version = result.qr.isMicro ? QR_MICRO_MAX_VERSION : QR_MAX_VERSION;
+    if (result.qrVersion > 0)
+    {
+        version = result.qrVersion;
+    }
+    else if (result.maxModules > 0)
+    {
+        version = GetQrVersionForWidth(result.maxModules);
+    }
+    const size_t capacity = result.qr.isMicro
+        ? GetQrMicroCapacity(version, result.qr.ecLevel, GetQrencodeMode(result.qr.mode))
+        : GetQrCapacity(version, result.qr.ecLevel, GetQrencodeMode(result.qr.mode));
+    const size_t cborLength = GetMessageUrCborLength(result.messageLength);
+
     if (result.isSinglePart)
     {
-        assert(result.messageLength <= MAX_LENGTH && "Message too long for single part UR");
+        assert(GetSinglePartUrLength(cborLength) <= capacity && "Message too long for single part UR");
     }
     else
     {
-        assert(result.messageLength >= result.maxFragmentLength && result.maxFragmentLength <= MAX_LENGTH && "Fragment too long");
+        const size_t maxFragmentLength = FindMaxFragmentLength(cborLength, capacity, result.isFountain ? SIZE_MAX : result.numExtraParts);
+        assert(maxFragmentLength > 0 && "QR version too small for a multi-part UR");
+        if (result.qrVersion > 0 || result.maxModules > 0)
+        {
+            result.maxFragmentLength = std::min(maxFragmentLength, result.messageLength);
+        }
+        assert(result.messageLength >= result.maxFragmentLength && result.maxFragmentLength <= maxFragmentLength && "Fragment too long");
+        for (const auto fragmentLength : result.streamFragmentLengths)
+        {
+            assert(result.messageLength >= fragmentLength && fragmentLength <= maxFragmentLength && "Stream fragment too long");
+        }
     }
 
     return result;
 }
 
 /**
- *  \brief  Generates a random message with a given length.
- *  \param  len Length of a generated message in bytes.
- *  \returns    Generated message.
+ *  \brief  Returns the QR version needed for a UR string, or 0 if it does not fit any version.
+ *  \param  ur  UR encoded string.
+ *  \param  qrOptions   QR encoder settings.
+ *  \param  mode    QR encoding mode that overrides the one in the settings.
  */
-static ur::ByteVector MakeMessage(const size_t len)
+static int GetQrVersion(const std::string& ur, const QrOptions& qrOptions, const QrEncodingMode mode)
 {
-    auto rng = ur::Xoshiro256(time(nullptr));
-    return rng.next_data(len);
+    QrOptions options = qrOptions;
+    options.mode = mode;
+    // The report shows the smallest version that fits, not the one forced by --qr-version.
+    options.version = 0;
+    try
+    {
+        return EncodeQr(ur, options)->version;
+    }
+    catch (const std::system_error&)
+    {
+        return 0;
+    }
 }
 
 /**
- *  \brief  Generates a random message with a given length and stores it as a UR object.
- *  \param  len Lengths of a generated message in bytes.
- *  \returns    UR object that containt the generated message.
+ *  \brief  Prints the QR versions reached by the UR strings of a message in both encoding modes.
+ *
+ *  A single part UR is reported as is. For a multi-part UR the fragment length is swept up to the
+ *  message length and the longest part of each sequence is reported. The QR version depends only
+ *  on the length of the string, so only that part is encoded.
+ *
+ *  \param  message A message that will be encoded.
+ *  \param  args    Command line arguments.
  */
-static ur::UR MakeMessageUr(const size_t len)
+static void PrintQrReport(const ur::UR& message, const CommandLineArguments& args)
 {
-    const auto message = MakeMessage(len);
-    ur::ByteVector cbor;
-    ur::CborLite::encodeBytes(cbor, message);
-    return ur::UR("bytes", cbor);
+    std::vector<size_t> fragmentLengths;
+    if (args.isSinglePart)
+    {
+        fragmentLengths.push_back(0);
+    }
+    else
+    {
+        for (size_t len = 10; len < args.messageLength; len = len * 3 / 2)
+        {
+            fragmentLengths.push_back(len);
+        }
+        fragmentLengths.push_back(args.messageLength);
+        fragmentLengths.push_back(args.maxFragmentLength);
+        std::sort(fragmentLengths.begin(), fragmentLengths.end());
+        fragmentLengths.erase(std::unique(fragmentLengths.begin(), fragmentLengths.end()), fragmentLengths.end());
+    }
+
+    std::cout << "fragment [B]\tparts\tUR length\tbyte version\talnum version" << std::endl;
+    for (const auto fragmentLength : fragmentLengths)
+    {
+        const auto urs = fragmentLength == 0
+            ? std::vector<std::string>{GenerateSinglePartUr(message)}
+            : GenerateMultiPartUr(message, fragmentLength);
+        const auto& longest = *std::max_element(urs.begin(), urs.end(), [](const auto& a, const auto& b){ return a.size() < b.size(); });
+
+        std::cout << (fragmentLength == 0 ? message.cbor().size() : fragmentLength) << "\t"
+            << urs.size() << "\t"
+            << longest.size() << "\t"
+            << GetQrVersion(longest, args.qr, QrEncodingMode::Byte) << "\t"
+            << GetQrVersion(longest, args.qr, QrEncodingMode::Alphanumeric) << std::endl;
+    }
 }
 
 /**
- *  \brief  Encodes the given message as a single part UR.
- *  \param  message A message that will be encoded.
- *  \returns    UR encoded string.
+ *  \brief  Processes HighGUI events until a deadline.
+ *
+ *  cv::waitKey() only has a millisecond resolution, so it is used for the bulk of the wait and the
+ *  rest is slept.
+ *
+ *  \param  deadline    Time to wait for.
+ *  \returns    Code of a pressed key or -1.
  */
-static std::string GenerateSinglePartUr(const ur::UR& message)
+static int WaitUntil(const FrameScheduler::Clock::time_point deadline)
 {
-    return ur::UREncoder::encode(message);
+    for (;;)
+    {
+        const auto remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - FrameScheduler::Clock::now()).count();
+        if (remainingMs < 2)
+        {
+            const int key = cv::pollKey();
+            std::this_thread::sleep_until(deadline);
+            return key;
+        }
+        const int key = cv::waitKey(static_cast<int>(remainingMs - 1));
+        if (key != -1)
+        {
+            return key;
+        }
+    }
 }
 
 /**
- *  \brief  Encodes the given message as a multi-part UR.
- *  \param  message A message that will be encoded.
- *  \param  maxFragmentLen  Maximum length of a fragment in bytes.
- *  \param  numExtraParts   Number of extra fragments.
- *  \returns    UR encoded strings.
+ *  \brief  Shows the frames of a stream until ESC is pressed.
+ *
+ *  Frames are shown at absolute deadlines, so the frame rate does not drift. A jitter report is
+ *  printed to stderr on exit.
+ *
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator.
+ *  \param  fps Number of frames per second.
  */
-static std::vector<std::string> GenerateMultiPartUr(const ur::UR& message, const size_t maxFragmentLen, const size_t numExtraParts = 0)
+template <typename Stream>
+static void Present(Stream& stream, const double fps)
 {
-    auto encoder = ur::UREncoder(message, maxFragmentLen);
-
-    std::vector<std::string> result;
-    for (size_t i = 0; i < encoder.seq_len() + numExtraParts; ++i)
+    FrameScheduler scheduler(fps);
+    Frame frame;
+    while (stream.Next(frame))
     {
-        result.emplace_back(encoder.next_part());
+        if (WaitUntil(scheduler.NextDeadline()) == 27)
+        {
+            break;
+        }
+        {
+            StageTimer timer(Stage::Presentation);
+            cv::imshow("QUR", frame.image);
+            cv::pollKey();
+        }
+        scheduler.FrameShown(FrameScheduler::Clock::now());
+        RecordFramePresented();
     }
-    return result;
+    scheduler.PrintReport(std::cerr);
 }
 
 /**
- *  \brief  Creates a lifehash image of a given message.
- *  \param  message Message whose lifehash image will be computed.
- *  \param  size    Size of the created lifehash image.
- *  \returns    Lifehash image.
+ *  \brief  Writes the frames of a stream and a manifest of UR strings into a directory.
+ *
+ *  Frames are PNG encoded in parallel batches. Each line of the manifest contains a frame file
+ *  name and the UR string it encodes, separated by a tab.
+ *
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator. It must be finite.
+ *  \param  batchSize   Number of frames encoded in parallel.
+ *  \param  outDir  Output directory. It is created if it does not exist.
+ *  \param  verifier    Loopback verifier that receives the written frames, or nullptr.
  */
-static cv::Mat CreateLifeHashImage(const ur::UR& message, const int size)
+template <typename Stream>
+static void WriteFrames(Stream& stream, const size_t batchSize, const std::string& outDir, LoopbackVerifier* verifier)
 {
-    const auto lifeHash = LifeHash::make_from_data(message.cbor());
-    cv::Mat lifeHashImage(cv::Size(lifeHash.width, lifeHash.height), CV_8UC3);
-    for (size_t r = 0; r < lifeHashImage.rows; ++r)
+    const auto dir = std::filesystem::path(outDir);
+    std::filesystem::create_directories(dir);
+
+    const auto digits = std::max(6, static_cast<int>(std::to_string(stream.CycleLength()).size()));
+    const auto fileName = [digits](const size_t index)
     {
-        for (size_t c = 0; c <lifeHashImage.cols; ++c)
+        std::ostringstream name;
+        name << "frame_" << std::setw(digits) << std::setfill('0') << index << ".png";
+        return name.str();
+    };
+
+    std::ofstream manifest(dir / "manifest.txt");
+    std::vector<Frame> batch(batchSize);
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < batch.size() && stream.Next(batch[count]))
+        {
+            ++count;
+        }
+        if (count == 0)
         {
-            const auto i = 3 * (r * lifeHash.width + c);
-            lifeHashImage.at<cv::Vec3b>(r, c) = cv::Vec3b(lifeHash.colors[i+2], lifeHash.colors[i+1], lifeHash.colors[i]);
+            break;
         }
+
+        // Exceptions must not leave the parallel body, so failures are collected and reported after it.
+        std::vector<char> isWritten(count, 0);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; ++i)
+            {
+                StageTimer timer(Stage::Presentation);
+                try
+                {
+                    isWritten[i] = cv::imwrite((dir / fileName(batch[i].index)).string(), batch[i].image);
+                }
+                catch (const cv::Exception&)
+                {
+                    // Reported below like any other failed write.
+                }
+                if (isWritten[i])
+                {
+                    RecordFramePresented();
+                }
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!isWritten[i])
+            {
+                throw std::runtime_error("Cannot write frame " + fileName(batch[i].index));
+            }
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            manifest << fileName(batch[i].index) << '\t' << batch[i].ur << '\n';
+            if (verifier)
+            {
+                verifier->Submit(batch[i]);
+            }
+        }
+    }
+
+    if (!manifest)
+    {
+        throw std::runtime_error("Cannot write manifest");
     }
-    cv::resize(lifeHashImage, lifeHashImage, cv::Size(size, size), 0, 0, cv::INTER_NEAREST);
-    return lifeHashImage;
 }
 
 /**
- *  \brief  UR encodes the given message.
- *  \param  message A message that will be encoded.
- *  \param  args    Command line arguments.
- *  \returns    A vector of UR encoded strings.
+ *  \brief  Writes the frames of a stream into a video file.
+ *
+ *  Frames are passed to the writer as they arrive, so only the stream lookahead is kept in memory.
+ *
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator. It must be finite.
+ *  \param  path    Output video file.
+ *  \param  codec   FourCC of the video codec.
+ *  \param  fps Number of frames per second.
+ *  \param  verifier    Loopback verifier that receives the written frames, or nullptr.
  */
-static std::vector<std::string> CreateUrs(const ur::UR& message, const CommandLineArguments& args)
+template <typename Stream>
+static void WriteVideo(Stream& stream, const std::string& path, const std::string& codec, const double fps, LoopbackVerifier* verifier)
 {
-    if (args.isSinglePart)
+    cv::VideoWriter writer;
+    Frame frame;
+    while (stream.Next(frame))
     {
-        return {GenerateSinglePartUr(message)};
+        if (!writer.isOpened() && !writer.open(path, cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]), fps, frame.image.size()))
+        {
+            throw std::runtime_error("Cannot open video " + path + " with codec " + codec);
+        }
+        {
+            StageTimer timer(Stage::Presentation);
+            writer.write(frame.image);
+        }
+        RecordFramePresented();
+        if (verifier)
+        {
+            verifier->Submit(frame);
+        }
     }
-    return GenerateMultiPartUr(message, args.maxFragmentLength, args.numExtraParts);
 }
 
 /**
- *  \brief  Creates QR images that contains UR encoded strings.
- *  \param  urs A vector of UR encoded strings.
- *  \param  size    Size of the created QR images.
- *  \returns    A vector of QR images.
+ *  \brief  Writes the frames of a stream to stdout as a raw video stream.
+ *
+ *  Writing stops at the end of the stream or when the reader closes stdout. When paced, frames
+ *  are written at absolute deadlines and a jitter report is printed to stderr on exit.
+ *
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator.
+ *  \param  format  Pixel format.
+ *  \param  fps Number of frames per second.
+ *  \param  pace    Write frames at the given rate instead of as fast as possible.
+ *  \param  verifier    Loopback verifier that receives the written frames, or nullptr.
  */
-static std::vector<cv::Mat> CreateQurImages(const std::vector<std::string>& urs, const int size)
+template <typename Stream>
+static void WriteRaw(Stream& stream, const RawFormat format, const double fps, const bool pace, LoopbackVerifier* verifier)
 {
-    std::vector<QRcode*> qurs;
-    std::transform(urs.begin(), urs.end(), std::back_inserter(qurs), [](const auto& ur){ return QRcode_encodeString8bit(ur.c_str(), 0, QR_ECLEVEL_L); });
-
-    std::vector<cv::Mat> qurImages;
-    for (const auto qur : qurs)
+#ifdef SIGPIPE
+    // A reader that closes the pipe ends the stream instead of killing the process.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    RawFrameWriter writer(stdout, format, fps);
+    FrameScheduler scheduler(fps);
+    Frame frame;
+    while (stream.Next(frame))
     {
-        qurImages.emplace_back(qur->width, qur->width, CV_8U);
-        for (int r = 0; r < qurImages.back().rows; ++r)
+        if (pace)
         {
-            for (int c = 0; c < qurImages.back().cols; ++c)
-            {
-                qurImages.back().at<uchar>(r, c) = (*(qur->data + r * qurImages.back().rows + c) % 2 == 1) ? 0 : 255;
-            }
+            std::this_thread::sleep_until(scheduler.NextDeadline());
+        }
+        bool isWritten = false;
+        {
+            StageTimer timer(Stage::Presentation);
+            isWritten = writer.Write(frame.image);
         }
-        cv::resize(qurImages.back(), qurImages.back(), cv::Size(size, size), 0, 0, cv::INTER_NEAREST);
-        cv::cvtColor(qurImages.back(), qurImages.back(), cv::COLOR_GRAY2BGR);
+        if (!isWritten)
+        {
+            break;
+        }
+        if (pace)
+        {
+            scheduler.FrameShown(FrameScheduler::Clock::now());
+        }
+        RecordFramePresented();
+        if (verifier)
+        {
+            verifier->Submit(frame);
+        }
+    }
+    std::fflush(stdout);
+    if (pace)
+    {
+        scheduler.PrintReport(std::cerr);
     }
+}
 
-    return qurImages;
+/**
+ *  \brief  Publishes the frames of a stream into a shared-memory frame ring.
+ *
+ *  The ring is removed when the stream ends. When paced, frames are published at absolute
+ *  deadlines and a jitter report is printed to stderr on exit.
+ *
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator.
+ *  \param  name    Name of the shared-memory object.
+ *  \param  numSlots    Number of slots of the ring.
+ *  \param  fps Number of frames per second.
+ *  \param  pace    Publish frames at the given rate instead of as fast as possible.
+ *  \param  verifier    Loopback verifier that receives the published frames, or nullptr.
+ */
+template <typename Stream>
+static void WriteShm(Stream& stream, const std::string& name, const size_t numSlots, const double fps, const bool pace, LoopbackVerifier* verifier)
+{
+    ShmRingWriter writer(name, numSlots, GetQrCapacity(QR_MAX_VERSION, QR_ECLEVEL_L, QR_MODE_AN), fps);
+    FrameScheduler scheduler(fps);
+    Frame frame;
+    while (stream.Next(frame))
+    {
+        if (pace)
+        {
+            std::this_thread::sleep_until(scheduler.NextDeadline());
+        }
+        const auto displayTime = FrameScheduler::Clock::now();
+        {
+            StageTimer timer(Stage::Presentation);
+            writer.Write(frame, displayTime);
+        }
+        if (pace)
+        {
+            scheduler.FrameShown(displayTime);
+        }
+        RecordFramePresented();
+        if (verifier)
+        {
+            verifier->Submit(frame);
+        }
+    }
+    if (pace)
+    {
+        scheduler.PrintReport(std::cerr);
+    }
 }
 
 /**
- *  \brief  Shows the lifehash and the QR images.
- *  \param  lifeHashImage   A lifehash image of a message.
- *  \param  qurImages   A vector of QR images that contain UR encoded message.
+ *  \brief  Passes the frames of a stream to a loopback verifier until the message is recovered.
+ *  \param  stream  Stream of composed frames, a FrameStream or a CameraSimulator. It must be finite.
+ *  \param  verifier    Loopback verifier.
  */
-static void Present(const cv::Mat& lifeHashImage, const std::vector<cv::Mat>& qurImages, const int fps)
+template <typename Stream>
+static void VerifyFrames(Stream& stream, LoopbackVerifier& verifier)
 {
-    int size = lifeHashImage.cols;
-    for (const auto& img : qurImages)
+    Frame frame;
+    while (!verifier.IsComplete() && stream.Next(frame))
     {
-        size = std::max(img.cols, size);
+        verifier.Submit(frame);
     }
+}
 
-    std::vector<cv::Mat> images;
-    for (const auto& qurImage : qurImages)
+/**
+ *  \brief  Runs a parameter sweep and writes the CSV to a file or to stdout.
+ *
+ *  Ranges that are not given on the command line consist of the single value of the
+ *  corresponding option.
+ *
+ *  \param  args    Parsed command line arguments.
+ *  \param  streamOptions   Settings shared by all configurations.
+ */
+static void WriteSweep(const CommandLineArguments& args, const FrameStreamOptions& streamOptions)
+{
+    const auto orDefault = [](const std::vector<double>& values, const double value)
     {
-        const int MARGIN = 10;
-        images.emplace_back(cv::Size(2*MARGIN + size, 3*MARGIN + lifeHashImage.rows + size), CV_8UC3, cv::Scalar(255, 255, 255));
-        
-        const cv::Rect lifeHashRoi((images.back().cols - lifeHashImage.cols) >> 1, MARGIN, lifeHashImage.cols, lifeHashImage.rows);
-        lifeHashImage.copyTo(images.back()(lifeHashRoi));
+        return values.empty() ? std::vector<double>{value} : values;
+    };
 
-        const cv::Rect qurImageRoi((images.back().cols - qurImage.cols) >> 1, 2*MARGIN + lifeHashImage.rows, qurImage.cols, qurImage.rows);
-        qurImage.copyTo(images.back()(qurImageRoi));
+    SweepOptions options;
+    for (const auto value : orDefault(args.sweepMessageLengths, args.messageLength))
+    {
+        options.messageLengths.push_back(static_cast<size_t>(value));
+    }
+    for (const auto value : orDefault(args.sweepFragmentLengths, args.maxFragmentLength))
+    {
+        options.fragmentLengths.push_back(static_cast<size_t>(value));
     }
+    for (const auto value : orDefault(args.sweepQrSizes, args.qrSize))
+    {
+        options.qrSizes.push_back(static_cast<int>(value));
+    }
+    options.ecLevels = args.sweepEcLevels.empty() ? std::vector<QRecLevel>{args.qr.ecLevel} : args.sweepEcLevels;
+    options.fpss = orDefault(args.sweepFpss, args.fps);
+    options.maskPolicies = args.sweepMaskPolicies;
+    options.stream = streamOptions;
+    options.simulateCamera = args.simulateCamera;
+    options.camera = args.camera;
+    options.numTrials = args.numSweepTrials;
+    options.seed = args.seed;
+    options.numLoops = args.numLoops;
 
-    int i = 0;
-    while (cv::waitKey(1000.0 / fps) != 27)
+    if (args.sweepPath == "-")
+    {
+        RunSweep(options, std::cout);
+        return;
+    }
+    std::ofstream file(args.sweepPath);
+    RunSweep(options, file);
+    if (!file)
     {
-        cv::imshow("QUR", images[i]);
-        i = (++i) % images.size();
+        throw std::runtime_error("Cannot write sweep to " + args.sweepPath);
     }
+}
 
+/**
+ *  \brief  Writes the pipeline statistics to a file or to stdout.
+ *  \param  path    Output file, '-' for stdout.
+ */
+static void WriteStats(const std::string& path)
+{
+    if (path == "-")
+    {
+        WritePipelineStats(std::cout);
+        return;
+    }
+    std::ofstream file(path);
+    WritePipelineStats(file);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot write statistics to " + path);
+    }
 }
 
 int main(int argc, char** argv)
 {
     const auto args = ParseCommandLineArguments(argc, argv);
 
-    const auto message = MakeMessageUr(args.messageLength);
-    
-    const auto lifeHashImage = CreateLifeHashImage(message, args.lifeHashImageSize);
+    if (args.numThreads > 0)
+    {
+        cv::setNumThreads(args.numThreads);
+    }
+    std::cerr << "Seed: " << args.seed << std::endl;
+
+    if (!args.corpusPath.empty())
+    {
+        CorpusOptions corpusOptions;
+        corpusOptions.path = args.corpusPath;
+        corpusOptions.numCases = args.numCorpusCases;
+        corpusOptions.seed = args.seed;
+        corpusOptions.maxMessageLength = args.messageLength;
+        corpusOptions.maxFragmentLength = args.maxFragmentLength;
+        corpusOptions.numExtraParts = args.numExtraParts;
+        WriteCorpus(corpusOptions);
+        return 0;
+    }
+
+    if (args.numSimulationTrials > 0)
+    {
+        FountainSimulationOptions simulationOptions;
+        simulationOptions.messageLength = args.messageLength;
+        simulationOptions.maxFragmentLength = args.maxFragmentLength;
+        simulationOptions.numTrials = args.numSimulationTrials;
+        simulationOptions.lossRate = args.lossRate;
+        simulationOptions.meanBurstLength = args.meanBurstLength;
+        simulationOptions.numThreads = args.numThreads;
+        simulationOptions.seed = args.seed;
+        PrintFountainSimulation(RunFountainSimulation(simulationOptions), std::cout);
+        return 0;
+    }
+
+    const auto message = [&]
+    {
+        StageTimer timer(Stage::MessageGeneration);
+        return MakeMessageUr(args.messageLength, args.seed);
+    }();
+
+    if (args.printQrReport)
+    {
+        PrintQrReport(message, args);
+        return 0;
+    }
+
+    FrameStreamOptions streamOptions;
+    streamOptions.isSinglePart = args.isSinglePart;
+    streamOptions.maxFragmentLength = args.maxFragmentLength;
+    streamOptions.numExtraParts = args.numExtraParts;
+    streamOptions.isFountain = args.isFountain;
+    streamOptions.qr = args.qr;
+    streamOptions.qrSize = args.qrSize;
+    streamOptions.lifeHashImageSize = args.lifeHashImageSize;
+    streamOptions.degradation = args.degradation;
+    streamOptions.lookahead = std::max(16, 2 * cv::getNumThreads());
+
+    if (!args.sweepPath.empty())
+    {
+        WriteSweep(args, streamOptions);
+        return 0;
+    }
+
+    std::unique_ptr<LoopbackVerifier> verifier;
+    if (args.verify)
+    {
+        verifier = std::make_unique<LoopbackVerifier>(message, streamOptions.lookahead);
+    }
+
+    // Only the window shows frames until it is closed; all other outputs are finite.
+    size_t numLoops = 0;
+    if (!args.outDir.empty() && !args.simulateCamera)
+    {
+        numLoops = 1;
+    }
+    else if (!args.outDir.empty() || !args.videoPath.empty() || args.writeStdout || !args.shmName.empty() || verifier || args.simulateCamera)
+    {
+        numLoops = args.numLoops;
+    }
+    streamOptions.numFrames = numLoops * UrSource(message, streamOptions).CycleLength();
+
+    const auto output = [&](auto& stream, const double fps)
+    {
+        if (!args.outDir.empty())
+        {
+            WriteFrames(stream, streamOptions.lookahead, args.outDir, verifier.get());
+        }
+        else if (!args.videoPath.empty())
+        {
+            WriteVideo(stream, args.videoPath, args.videoCodec, fps, verifier.get());
+        }
+        else if (args.writeStdout)
+        {
+            WriteRaw(stream, args.rawFormat, fps, args.pace, verifier.get());
+        }
+        else if (!args.shmName.empty())
+        {
+            WriteShm(stream, args.shmName, args.numShmSlots, fps, args.pace, verifier.get());
+        }
+        else if (verifier)
+        {
+            VerifyFrames(stream, *verifier);
+        }
+        else
+        {
+            Present(stream, fps);
+        }
+    };
+
+    const auto film = [&](auto& stream)
+    {
+        if (args.simulateCamera)
+        {
+            CameraSimulator camera([&stream](Frame& frame){ return stream.Next(frame); }, stream.CycleLength(), args.fps, args.camera);
+            output(camera, args.camera.fps);
+            PrintCameraStats(camera.Stats(), std::cerr);
+        }
+        else
+        {
+            output(stream, args.fps);
+        }
+    };
 
-    const auto urs = CreateUrs(message, args);
+    if (args.numStreams > 1)
+    {
+        std::vector<ur::UR> messages{message};
+        {
+            StageTimer timer(Stage::MessageGeneration);
+            for (size_t i = 1; i < args.numStreams; ++i)
+            {
+                messages.push_back(MakeMessageUr(args.messageLength, static_cast<uint32_t>(args.seed + i)));
+            }
+        }
+        TiledStreamOptions tiledOptions;
+        tiledOptions.stream = streamOptions;
+        tiledOptions.fragmentLengths = args.streamFragmentLengths;
+        tiledOptions.phases = args.streamPhases;
+        tiledOptions.numLoops = numLoops;
+        TiledStream stream(messages, tiledOptions);
+        film(stream);
+    }
+    else
+    {
+        FrameStream stream(message, streamOptions);
+        film(stream);
+    }
 
-    const auto qurImages = CreateQurImages(urs, args.qrSize);
+    if (verifier)
+    {
+        PrintLoopbackResult(verifier->Finish(), std::cerr);
+    }
 
-    Present(lifeHashImage, qurImages, args.fps);
+    if (!args.statsPath.empty())
+    {
+        WriteStats(args.statsPath);
+    }
 
     return 0;
 }
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pipeline_stats.hpp"
+
+#include <array>
+#include <atomic>
+
+#include <sys/resource.h>
+
+#include "alloc_stats.hpp"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const char* const STAGE_NAMES[NUM_STAGES] =
+{
+    "message_generation",
+    "ur_encoding",
+    "qr_encoding",
+    "rasterization",
+    "lifehash",
+    "composition",
+    "degradation",
+    "capture",
+    "presentation",
+};
+
+const Clock::time_point g_processStart = Clock::now();
+std::array<std::atomic<int64_t>, NUM_STAGES> g_stageNs{};
+std::array<std::atomic<uint64_t>, NUM_STAGES> g_stageCalls{};
+std::atomic<uint64_t> g_framesRendered{0};
+std::atomic<uint64_t> g_framesPresented{0};
+std::atomic<int64_t> g_firstFrameNs{-1};
+
+int64_t NanosecondsSince(const Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+}
+
+StageTimer::StageTimer(const Stage stage)
+    : m_stage(stage)
+    , m_start(Clock::now())
+{
+}
+
+StageTimer::~StageTimer()
+{
+    const auto i = static_cast<size_t>(m_stage);
+    g_stageNs[i].fetch_add(NanosecondsSince(m_start), std::memory_order_relaxed);
+    g_stageCalls[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordFrameRendered()
+{
+    g_framesRendered.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordFramePresented()
+{
+    if (g_framesPresented.fetch_add(1, std::memory_order_relaxed) == 0)
+    {
+        g_firstFrameNs = NanosecondsSince(g_processStart);
+    }
+}
+
+void WritePipelineStats(std::ostream& os)
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto allocations = GetAllocationStats();
+
+    os << "{" << std::endl;
+    os << "  \"stages\": {" << std::endl;
+    for (size_t i = 0; i < NUM_STAGES; ++i)
+    {
+        os << "    \"" << STAGE_NAMES[i] << "\": {\"calls\": " << g_stageCalls[i].load()
+            << ", \"time_ns\": " << g_stageNs[i].load() << "}" << (i + 1 < NUM_STAGES ? "," : "") << std::endl;
+    }
+    os << "  }," << std::endl;
+    os << "  \"frames_rendered\": " << g_framesRendered.load() << "," << std::endl;
+    os << "  \"frames_presented\": " << g_framesPresented.load() << "," << std::endl;
+    os << "  \"first_frame_ns\": " << g_firstFrameNs.load() << "," << std::endl;
+    os << "  \"wall_time_ns\": " << NanosecondsSince(g_processStart) << "," << std::endl;
+    os << "  \"user_time_us\": " << usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec << "," << std::endl;
+    os << "  \"system_time_us\": " << usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec << "," << std::endl;
+    // ru_maxrss is reported in kilobytes on Linux.
+    os << "  \"peak_rss_bytes\": " << static_cast<int64_t>(usage.ru_maxrss) * 1024 << "," << std::endl;
+    os << "  \"allocations\": " << allocations.count << "," << std::endl;
+    os << "  \"allocated_bytes\": " << allocations.bytes << std::endl;
+    os << "}" << std::endl;
+}
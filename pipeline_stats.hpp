@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+
+/**
+ *  \brief  Stages of the frame pipeline whose time is measured.
+ */
+enum class Stage
+{
+    MessageGeneration,
+    UrEncoding,
+    QrEncoding,
+    Rasterization,
+    LifeHash,
+    Composition,
+    Degradation,
+    Capture,
+    Presentation,
+};
+
+/// Number of pipeline stages.
+constexpr size_t NUM_STAGES = static_cast<size_t>(Stage::Presentation) + 1;
+
+/**
+ *  \brief  Adds the time between its construction and destruction to a pipeline stage.
+ *
+ *  Stages run concurrently on several threads, so the time of a stage is summed over all threads
+ *  and can exceed the wall-clock time.
+ */
+class StageTimer
+{
+public:
+    explicit StageTimer(const Stage stage);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    const Stage m_stage;
+    const std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+ *  \brief  Counts a frame that left the rendering stages.
+ */
+void RecordFrameRendered();
+
+/**
+ *  \brief  Counts a frame that was shown or written. The first one determines the startup latency.
+ */
+void RecordFramePresented();
+
+/**
+ *  \brief  Writes the pipeline statistics as a JSON document.
+ *
+ *  The document contains the time and the number of calls of every stage, the number of rendered
+ *  and presented frames, the time from the process start to the first presented frame, the total
+ *  wall-clock time, the peak resident set size and the heap allocation counters.
+ *
+ *  \param  os  Output stream.
+ */
+void WritePipelineStats(std::ostream& os);
@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+
+#include <qrencode.h>
+
+/// Smallest QR code version.
+constexpr int QR_MIN_VERSION = 1;
+/// Largest QR code version.
+constexpr int QR_MAX_VERSION = 40;
+
+/// Number of error correction codewords per block, indexed by EC level and version.
+constexpr int QR_ECC_CODEWORDS_PER_BLOCK[4][QR_MAX_VERSION + 1] =
+{
+    {0,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {0, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+};
+
+/// Number of error correction blocks, indexed by EC level and version.
+constexpr int QR_NUM_BLOCKS[4][QR_MAX_VERSION + 1] =
+{
+    {0, 1, 1, 1, 1, 1, 2, 2, 2, 2,  4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {0, 1, 1, 1, 2, 2, 4, 4, 4, 5,  5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {0, 1, 1, 2, 2, 4, 4, 6, 6, 8,  8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+    {0, 1, 1, 2, 4, 4, 4, 5, 6, 8,  8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},
+};
+
+/**
+ *  \brief  Returns the number of modules along one side of a QR code.
+ */
+constexpr int GetQrWidth(const int version)
+{
+    return 17 + 4 * version;
+}
+
+/**
+ *  \brief  Returns the largest QR version whose width does not exceed the given number of modules, or 0.
+ */
+constexpr int GetQrVersionForWidth(const int modules)
+{
+    return modules < GetQrWidth(QR_MIN_VERSION) ? 0 : (modules >= GetQrWidth(QR_MAX_VERSION) ? QR_MAX_VERSION : (modules - 17) / 4);
+}
+
+/**
+ *  \brief  Returns the number of codewords of a QR code, i.e. the modules not used by function patterns.
+ */
+constexpr int GetQrRawCodewords(const int version)
+{
+    int modules = (16 * version + 128) * version + 64;
+    if (version >= 2)
+    {
+        const int numAlign = version / 7 + 2;
+        modules -= (25 * numAlign - 10) * numAlign - 55;
+        if (version >= 7)
+        {
+            modules -= 36;
+        }
+    }
+    return modules / 8;
+}
+
+/**
+ *  \brief  Returns the number of data codewords of a QR code.
+ */
+constexpr int GetQrDataCodewords(const int version, const QRecLevel level)
+{
+    return GetQrRawCodewords(version) - QR_ECC_CODEWORDS_PER_BLOCK[level][version] * QR_NUM_BLOCKS[level][version];
+}
+
+/**
+ *  \brief  Returns the length of the character count indicator of a data segment.
+ */
+constexpr int GetQrCharCountBits(const int version, const QRencodeMode mode)
+{
+    const int range = version <= 9 ? 0 : (version <= 26 ? 1 : 2);
+    switch (mode)
+    {
+        case QR_MODE_NUM: return range == 0 ? 10 : (range == 1 ? 12 : 14);
+        case QR_MODE_AN: return range == 0 ? 9 : (range == 1 ? 11 : 13);
+        case QR_MODE_8: return range == 0 ? 8 : 16;
+        default: return 0;
+    }
+}
+
+/**
+ *  \brief  Computes the number of characters that fit a QR code as a single data segment.
+ *  \param  version QR version.
+ *  \param  level   Error correction level.
+ *  \param  mode    Numeric, alphanumeric or 8-bit mode.
+ *  \returns    Capacity in characters (bytes in 8-bit mode).
+ */
+constexpr int ComputeQrCapacity(const int version, const QRecLevel level, const QRencodeMode mode)
+{
+    const int bits = 8 * GetQrDataCodewords(version, level) - 4 - GetQrCharCountBits(version, mode);
+    switch (mode)
+    {
+        case QR_MODE_NUM: return bits / 10 * 3 + (bits % 10 >= 7 ? 2 : (bits % 10 >= 4 ? 1 : 0));
+        case QR_MODE_AN: return bits / 11 * 2 + (bits % 11 >= 6 ? 1 : 0);
+        case QR_MODE_8: return bits / 8;
+        default: return 0;
+    }
+}
+
+/// Capacity in characters indexed by version, EC level and mode (numeric, alphanumeric, 8-bit).
+constexpr auto QR_CAPACITY = []
+{
+    std::array<std::array<std::array<int, 3>, 4>, QR_MAX_VERSION + 1> table{};
+    for (int version = QR_MIN_VERSION; version <= QR_MAX_VERSION; ++version)
+    {
+        for (int level = QR_ECLEVEL_L; level <= QR_ECLEVEL_H; ++level)
+        {
+            for (int mode = QR_MODE_NUM; mode <= QR_MODE_8; ++mode)
+            {
+                table[version][level][mode] = ComputeQrCapacity(version, static_cast<QRecLevel>(level), static_cast<QRencodeMode>(mode));
+            }
+        }
+    }
+    return table;
+}();
+
+static_assert(QR_CAPACITY[1][QR_ECLEVEL_L][QR_MODE_8] == 17, "QR capacity table mismatch");
+static_assert(QR_CAPACITY[1][QR_ECLEVEL_H][QR_MODE_NUM] == 17, "QR capacity table mismatch");
+static_assert(QR_CAPACITY[10][QR_ECLEVEL_M][QR_MODE_8] == 213, "QR capacity table mismatch");
+static_assert(QR_CAPACITY[40][QR_ECLEVEL_L][QR_MODE_8] == 2953, "QR capacity table mismatch");
+static_assert(QR_CAPACITY[40][QR_ECLEVEL_L][QR_MODE_AN] == 4296, "QR capacity table mismatch");
+static_assert(QR_CAPACITY[40][QR_ECLEVEL_H][QR_MODE_NUM] == 3057, "QR capacity table mismatch");
+
+/**
+ *  \brief  Returns the number of characters that fit a QR code as a single data segment.
+ *  \param  version QR version.
+ *  \param  level   Error correction level.
+ *  \param  mode    Numeric, alphanumeric or 8-bit mode.
+ *  \returns    Capacity in characters (bytes in 8-bit mode).
+ */
+inline int GetQrCapacity(const int version, const QRecLevel level, const QRencodeMode mode)
+{
+    return QR_CAPACITY[version][level][mode];
+}
+
+/// Largest Micro QR version, M4.
+constexpr int QR_MICRO_MAX_VERSION = 4;
+
+/**
+ *  \brief  Capacity of Micro QR codes in characters indexed by version, EC level and mode.
+ *
+ *  M1 carries numeric data with error detection only, listed as level L like libqrencode does.
+ *  Level H does not exist in Micro QR.
+ */
+constexpr int QR_MICRO_CAPACITY[QR_MICRO_MAX_VERSION + 1][4][3] =
+{
+    {},
+    {{5, 0, 0}},
+    {{10, 6, 4}, {8, 5, 3}},
+    {{23, 14, 9}, {18, 11, 7}},
+    {{35, 21, 15}, {30, 18, 13}, {21, 13, 9}},
+};
+
+/**
+ *  \brief  Returns the number of modules along one side of a Micro QR code.
+ */
+constexpr int GetQrMicroWidth(const int version)
+{
+    return 9 + 2 * version;
+}
+
+/**
+ *  \brief  Returns the number of characters that fit a Micro QR code as a single data segment, 0 if the level does not exist.
+ */
+inline int GetQrMicroCapacity(const int version, const QRecLevel level, const QRencodeMode mode)
+{
+    return QR_MICRO_CAPACITY[version][level][mode];
+}
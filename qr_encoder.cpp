@@ -0,0 +1,730 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qr_encoder.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+
+/// Penalty weights of libqrencode.
+constexpr int PENALTY_N1 = 3;
+constexpr int PENALTY_N2 = 3;
+constexpr int PENALTY_N3 = 40;
+constexpr int PENALTY_N4 = 10;
+
+/**
+ *  \brief  Returns the value of an alphanumeric character, or -1 outside the set.
+ *
+ *  Lowercase letters map to their uppercase values.
+ */
+constexpr auto ALPHANUMERIC_VALUES = []
+{
+    std::array<int8_t, 256> values{};
+    for (auto& value : values)
+    {
+        value = -1;
+    }
+    const char* const CHARSET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+    for (int i = 0; CHARSET[i] != '\0'; ++i)
+    {
+        values[static_cast<uint8_t>(CHARSET[i])] = static_cast<int8_t>(i);
+        if (CHARSET[i] >= 'A' && CHARSET[i] <= 'Z')
+        {
+            values[static_cast<uint8_t>(CHARSET[i] - 'A' + 'a')] = static_cast<int8_t>(i);
+        }
+    }
+    return values;
+}();
+
+/**
+ *  \brief  Appends bits MSB first to zero-initialized codewords.
+ */
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* data)
+        : m_data(data)
+    {
+    }
+
+    void Write(const uint32_t value, const int numBits)
+    {
+        for (int i = numBits - 1; i >= 0; --i)
+        {
+            m_data[m_position >> 3] |= ((value >> i) & 1) << (7 - (m_position & 7));
+            ++m_position;
+        }
+    }
+
+    size_t Position() const
+    {
+        return m_position;
+    }
+
+private:
+    uint8_t* m_data;
+    size_t m_position = 0;
+};
+
+/**
+ *  \brief  Returns true if a mask pattern inverts the module at row y and column x.
+ */
+bool IsMasked(const int mask, const int x, const int y)
+{
+    switch (mask)
+    {
+        case 0: return (x + y) % 2 == 0;
+        case 1: return y % 2 == 0;
+        case 2: return x % 3 == 0;
+        case 3: return (x + y) % 3 == 0;
+        case 4: return (y / 2 + x / 3) % 2 == 0;
+        case 5: return (x * y) % 2 + (x * y) % 3 == 0;
+        case 6: return ((x * y) % 2 + (x * y) % 3) % 2 == 0;
+        default: return ((x * y) % 3 + (x + y) % 2) % 2 == 0;
+    }
+}
+
+/**
+ *  \brief  Computes the run lengths of a line of modules.
+ *
+ *  Even entries are light and odd entries dark runs. A line that starts dark gets a leading light
+ *  run of length -1, as in libqrencode.
+ *
+ *  \returns    Number of runs.
+ */
+int GetRunLengths(const uint8_t* modules, const int width, const int stride, int* runs)
+{
+    int head = 0;
+    if (modules[0] & 1)
+    {
+        runs[0] = -1;
+        head = 1;
+    }
+    runs[head] = 1;
+    uint8_t previous = modules[0] & 1;
+    for (int i = 1; i < width; ++i)
+    {
+        const uint8_t module = modules[i * stride] & 1;
+        if (module != previous)
+        {
+            runs[++head] = 1;
+            previous = module;
+        }
+        else
+        {
+            ++runs[head];
+        }
+    }
+    return head + 1;
+}
+
+/**
+ *  \brief  Computes the penalties of long runs and finder-like patterns in a line.
+ */
+int GetRunPenalty(const int* runs, const int length)
+{
+    int penalty = 0;
+    for (int i = 0; i < length; ++i)
+    {
+        if (runs[i] >= 5)
+        {
+            penalty += PENALTY_N1 + (runs[i] - 5);
+        }
+        // A dark run of 3 units between dark, light, light and dark runs of 1 unit.
+        if ((i & 1) && i >= 3 && i < length - 2 && runs[i] % 3 == 0)
+        {
+            const int unit = runs[i] / 3;
+            if (runs[i - 2] == unit && runs[i - 1] == unit && runs[i + 1] == unit && runs[i + 2] == unit)
+            {
+                if (i == 3 || runs[i - 3] >= 4 * unit || i + 4 >= length || runs[i + 3] >= 4 * unit)
+                {
+                    penalty += PENALTY_N3;
+                }
+            }
+        }
+    }
+    return penalty;
+}
+
+/**
+ *  \brief  Calls f(x, y, bit) for both copies of every format information bit.
+ */
+template <typename F>
+void ForEachFormatModule(const int width, const uint16_t format, F f)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        const bool bit = (format >> i) & 1;
+        f(width - 1 - i, 8, bit);
+        f(8, i < 6 ? i : i + 1, bit);
+    }
+    for (int i = 0; i < 7; ++i)
+    {
+        const bool bit = (format >> (8 + i)) & 1;
+        f(8, width - 7 + i, bit);
+        f(i == 0 ? 7 : 6 - i, 8, bit);
+    }
+}
+
+/**
+ *  \brief  Returns a mask of the bits of word w that lie inside a line of width modules.
+ */
+uint64_t GetValidBits(const int w, const int width)
+{
+    const int numBits = width - 64 * w;
+    return numBits >= 64 ? ~uint64_t(0) : numBits <= 0 ? 0 : (uint64_t(1) << numBits) - 1;
+}
+
+/**
+ *  \brief  Computes the run lengths of a bit-packed line in the layout of GetRunLengths.
+ */
+int GetPackedRunLengths(const uint64_t* line, const int width, int* runs)
+{
+    int head = 0;
+    if (line[0] & 1)
+    {
+        runs[head++] = -1;
+    }
+    int start = 0;
+    for (int w = 0; w < QR_PACKED_WORDS; ++w)
+    {
+        // Bits that differ from the module before them start a new run.
+        const uint64_t previous = line[w] << 1 | (w > 0 ? line[w - 1] >> 63 : line[0] & 1);
+        uint64_t changes = (line[w] ^ previous) & GetValidBits(w, width);
+        while (changes != 0)
+        {
+            const int x = 64 * w + __builtin_ctzll(changes);
+            runs[head++] = x - start;
+            start = x;
+            changes &= changes - 1;
+        }
+    }
+    runs[head++] = width - start;
+    return head;
+}
+
+/**
+ *  \brief  Transposes a 64 x 64 bit matrix in place by swapping ever smaller blocks.
+ */
+void Transpose64(uint64_t* rows)
+{
+    uint64_t mask = 0x00000000ffffffff;
+    for (int j = 32; j != 0; j >>= 1, mask ^= mask << j)
+    {
+        for (int k = 0; k < 64; k = (k + j + 1) & ~j)
+        {
+            const uint64_t t = ((rows[k] >> j) ^ rows[k + j]) & mask;
+            rows[k] ^= t << j;
+            rows[k + j] ^= t;
+        }
+    }
+}
+
+}
+
+int GetQrMaskPenalty(const uint8_t* modules, const int width)
+{
+    int penalty = 0;
+    int darkModules = 0;
+    for (int y = 0; y < width; ++y)
+    {
+        const uint8_t* row = modules + y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            darkModules += row[x] & 1;
+            if (x > 0 && y > 0)
+            {
+                const int sum = (row[x] & 1) + (row[x - 1] & 1) + (row[x - width] & 1) + (row[x - width - 1] & 1);
+                if (sum == 0 || sum == 4)
+                {
+                    penalty += PENALTY_N2;
+                }
+            }
+        }
+    }
+
+    int runs[QR_MAX_WIDTH + 1];
+    for (int y = 0; y < width; ++y)
+    {
+        penalty += GetRunPenalty(runs, GetRunLengths(modules + y * width, width, 1, runs));
+    }
+    for (int x = 0; x < width; ++x)
+    {
+        penalty += GetRunPenalty(runs, GetRunLengths(modules + x, width, width, runs));
+    }
+
+    const int area = width * width;
+    const int ratio = (200 * darkModules + area) / area / 2;
+    return penalty + std::abs(ratio - 50) / 5 * PENALTY_N4;
+}
+
+int GetQrMaskPenalty(const QrPackedModules& modules, const int width, const bool isRowsOnly)
+{
+    int penalty = 0;
+    int darkModules = 0;
+    for (int y = 0; y < width; ++y)
+    {
+        const auto& row = modules[y];
+        for (int w = 0; w < QR_PACKED_WORDS; ++w)
+        {
+            darkModules += __builtin_popcountll(row[w]);
+        }
+        if (y == 0)
+        {
+            continue;
+        }
+
+        // A 2 x 2 block starting at column x is uniform if both rows agree at x and each row
+        // agrees with itself between x and x + 1.
+        const auto& above = modules[y - 1];
+        for (int w = 0; w < QR_PACKED_WORDS; ++w)
+        {
+            const uint64_t nextRow = row[w] >> 1 | (w + 1 < QR_PACKED_WORDS ? row[w + 1] << 63 : 0);
+            const uint64_t nextAbove = above[w] >> 1 | (w + 1 < QR_PACKED_WORDS ? above[w + 1] << 63 : 0);
+            const uint64_t uniform = ~(row[w] ^ above[w]) & ~(row[w] ^ nextRow) & ~(above[w] ^ nextAbove);
+            penalty += PENALTY_N2 * __builtin_popcountll(uniform & GetValidBits(w, width - 1));
+        }
+    }
+
+    int runs[QR_MAX_WIDTH + 1];
+    for (int y = 0; y < width; ++y)
+    {
+        penalty += GetRunPenalty(runs, GetPackedRunLengths(modules[y].data(), width, runs));
+    }
+    if (!isRowsOnly)
+    {
+        QrPackedModules columns;
+        uint64_t block[64];
+        const int numBlocks = (width + 63) / 64;
+        for (int by = 0; by < numBlocks; ++by)
+        {
+            for (int bx = 0; bx < numBlocks; ++bx)
+            {
+                for (int i = 0; i < 64; ++i)
+                {
+                    block[i] = modules[64 * by + i][bx];
+                }
+                Transpose64(block);
+                for (int i = 0; i < 64; ++i)
+                {
+                    columns[64 * bx + i][by] = block[i];
+                }
+            }
+        }
+        for (int x = 0; x < width; ++x)
+        {
+            penalty += GetRunPenalty(runs, GetPackedRunLengths(columns[x].data(), width, runs));
+        }
+    }
+
+    const int area = width * width;
+    const int ratio = (200 * darkModules + area) / area / 2;
+    return penalty + std::abs(ratio - 50) / 5 * PENALTY_N4;
+}
+
+void PackQrModules(const uint8_t* modules, const int width, QrPackedModules& packed)
+{
+    for (auto& row : packed)
+    {
+        row.fill(0);
+    }
+    for (int y = 0; y < width; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            packed[y][x >> 6] |= uint64_t(modules[y * width + x] & 1) << (x & 63);
+        }
+    }
+}
+
+void ParseQrMaskPolicy(const std::string& spec, QrOptions& options)
+{
+    if (spec == "full")
+    {
+        options.maskPolicy = QrMaskPolicy::Full;
+    }
+    else if (spec == "fast")
+    {
+        options.maskPolicy = QrMaskPolicy::Fast;
+    }
+    else if (spec.size() == 1 && spec[0] >= '0' && spec[0] <= '7')
+    {
+        options.maskPolicy = QrMaskPolicy::Fixed;
+        options.fixedMask = spec[0] - '0';
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown mask policy " + spec);
+    }
+}
+
+std::string GetQrMaskPolicyName(const QrOptions& options)
+{
+    switch (options.maskPolicy)
+    {
+        case QrMaskPolicy::Fast: return "fast";
+        case QrMaskPolicy::Fixed: return std::to_string(options.fixedMask);
+        default: return "full";
+    }
+}
+
+RsBlockLayout GetQrBlockLayout(const int version, const QRecLevel level)
+{
+    const int numBlocks = QR_NUM_BLOCKS[level][version];
+    const int rawCodewords = GetQrRawCodewords(version);
+    RsBlockLayout layout;
+    layout.numShortBlocks = numBlocks - rawCodewords % numBlocks;
+    layout.numLongBlocks = rawCodewords % numBlocks;
+    layout.eccLength = QR_ECC_CODEWORDS_PER_BLOCK[level][version];
+    layout.shortDataLength = rawCodewords / numBlocks - layout.eccLength;
+    return layout;
+}
+
+int GetQrMask(const QRcode* qur)
+{
+    // Bits 10 to 12 of the format information, next to the top left finder pattern.
+    int format = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        const int row = i < 6 ? i : i + 1;
+        format |= (qur->data[row * qur->width + 8] & 1) << i;
+    }
+    for (int i = 0; i < 7; ++i)
+    {
+        const int col = i == 0 ? 7 : 6 - i;
+        format |= (qur->data[8 * qur->width + col] & 1) << (8 + i);
+    }
+    return ((format ^ 0x5412) >> 10) & 7;
+}
+
+QRcode QrEncoder::Encode(const std::string& ur, const QrOptions& options, const int mask)
+{
+    EncodeData(ur, options);
+    AddErrorCorrection();
+    PreparePatterns();
+    PlaceCodewords();
+
+    int chosenMask = mask;
+    if (chosenMask < 0)
+    {
+        chosenMask = options.maskPolicy == QrMaskPolicy::Fixed ? options.fixedMask : SelectMask(options.maskPolicy == QrMaskPolicy::Fast);
+    }
+    if (chosenMask < 0 || chosenMask > 7)
+    {
+        throw std::invalid_argument("Invalid QR mask " + std::to_string(chosenMask));
+    }
+    m_modules.resize(static_cast<size_t>(m_width) * m_width);
+    ApplyMask(chosenMask, m_level, m_modules.data());
+
+    QRcode result;
+    result.version = m_version;
+    result.width = m_width;
+    result.data = m_modules.data();
+    return result;
+}
+
+void QrEncoder::EncodeData(const std::string& ur, const QrOptions& options)
+{
+    const auto mode = GetQrencodeMode(options.mode);
+    m_level = options.ecLevel;
+    m_version = options.version > 0 ? options.version : QR_MIN_VERSION;
+    const int maxVersion = options.version > 0 ? options.version : QR_MAX_VERSION;
+    while (m_version <= maxVersion && static_cast<size_t>(GetQrCapacity(m_version, m_level, mode)) < ur.size())
+    {
+        ++m_version;
+    }
+    if (m_version > maxVersion)
+    {
+        throw std::invalid_argument("UR string of " + std::to_string(ur.size()) + " characters does not fit "
+            + (options.version > 0 ? "QR version " + std::to_string(options.version) : std::string("a QR code")));
+    }
+    m_width = GetQrWidth(m_version);
+
+    const int numDataCodewords = GetQrDataCodewords(m_version, m_level);
+    m_codewords.assign(GetQrRawCodewords(m_version), 0);
+    BitWriter writer(m_codewords.data());
+    if (mode == QR_MODE_AN)
+    {
+        writer.Write(0x2, 4);
+        writer.Write(static_cast<uint32_t>(ur.size()), GetQrCharCountBits(m_version, mode));
+        const auto value = [&ur](const size_t i)
+        {
+            const int result = ALPHANUMERIC_VALUES[static_cast<uint8_t>(ur[i])];
+            if (result < 0)
+            {
+                throw std::invalid_argument("Character outside the QR alphanumeric set");
+            }
+            return static_cast<uint32_t>(result);
+        };
+        size_t i = 0;
+        for (; i + 1 < ur.size(); i += 2)
+        {
+            writer.Write(45 * value(i) + value(i + 1), 11);
+        }
+        if (i < ur.size())
+        {
+            writer.Write(value(i), 6);
+        }
+    }
+    else
+    {
+        writer.Write(0x4, 4);
+        writer.Write(static_cast<uint32_t>(ur.size()), GetQrCharCountBits(m_version, mode));
+        for (const char c : ur)
+        {
+            writer.Write(static_cast<uint8_t>(c), 8);
+        }
+    }
+
+    // The terminator and the padding to a full codeword are zero bits, already in place.
+    const size_t capacityBits = 8 * static_cast<size_t>(numDataCodewords);
+    const size_t usedCodewords = (std::min(writer.Position() + 4, capacityBits) + 7) / 8;
+    for (size_t i = usedCodewords; i < static_cast<size_t>(numDataCodewords); ++i)
+    {
+        m_codewords[i] = (i - usedCodewords) % 2 == 0 ? 0xec : 0x11;
+    }
+}
+
+void QrEncoder::AddErrorCorrection()
+{
+    // Blocks are laid out in m_codewords as data of all blocks first, then the error correction
+    // codewords of all blocks; the short blocks come first.
+    const auto layout = GetQrBlockLayout(m_version, m_level);
+    const int numBlocks = layout.numShortBlocks + layout.numLongBlocks;
+    const int numShortBlocks = layout.numShortBlocks;
+    const int shortDataLength = layout.shortDataLength;
+    const int eccLength = layout.eccLength;
+    const int rawCodewords = GetQrRawCodewords(m_version);
+    const int numDataCodewords = GetQrDataCodewords(m_version, m_level);
+    EncodeRsBlocks(m_codewords.data(), layout, m_codewords.data() + numDataCodewords);
+
+    // Interleave the data codewords column by column, skipping the short blocks in the last
+    // column, then the error correction codewords.
+    m_interleaved.resize(rawCodewords);
+    size_t k = 0;
+    for (int i = 0; i <= shortDataLength; ++i)
+    {
+        size_t offset = 0;
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            const int dataLength = shortDataLength + (b >= numShortBlocks ? 1 : 0);
+            if (i < dataLength)
+            {
+                m_interleaved[k++] = m_codewords[offset + i];
+            }
+            offset += dataLength;
+        }
+    }
+    for (int i = 0; i < eccLength; ++i)
+    {
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            m_interleaved[k++] = m_codewords[numDataCodewords + b * eccLength + i];
+        }
+    }
+}
+
+void QrEncoder::PreparePatterns()
+{
+    if (m_patternVersion == m_version)
+    {
+        return;
+    }
+    const int width = m_width;
+    const size_t area = static_cast<size_t>(width) * width;
+    m_isFunction.assign(area, 0);
+    m_unmasked.assign(area, 0);
+    const auto set = [&](const int x, const int y, const bool isDark)
+    {
+        m_isFunction[y * width + x] = 1;
+        m_unmasked[y * width + x] = isDark;
+    };
+
+    for (int i = 0; i < width; ++i)
+    {
+        set(6, i, i % 2 == 0);
+        set(i, 6, i % 2 == 0);
+    }
+
+    // Finder patterns with their separators.
+    const int finderCenters[3][2] = {{3, 3}, {width - 4, 3}, {3, width - 4}};
+    for (const auto& center : finderCenters)
+    {
+        for (int dy = -4; dy <= 4; ++dy)
+        {
+            for (int dx = -4; dx <= 4; ++dx)
+            {
+                const int x = center[0] + dx;
+                const int y = center[1] + dy;
+                if (x >= 0 && x < width && y >= 0 && y < width)
+                {
+                    const int distance = std::max(std::abs(dx), std::abs(dy));
+                    set(x, y, distance != 2 && distance != 4);
+                }
+            }
+        }
+    }
+
+    const int numAlign = GetQrNumAlignmentPositions(m_version);
+    for (int i = 0; i < numAlign; ++i)
+    {
+        for (int j = 0; j < numAlign; ++j)
+        {
+            // Alignment patterns overlapping the finder patterns are left out.
+            if ((i == 0 && j == 0) || (i == 0 && j == numAlign - 1) || (i == numAlign - 1 && j == 0))
+            {
+                continue;
+            }
+            const int cx = GetQrAlignmentPosition(m_version, i);
+            const int cy = GetQrAlignmentPosition(m_version, j);
+            for (int dy = -2; dy <= 2; ++dy)
+            {
+                for (int dx = -2; dx <= 2; ++dx)
+                {
+                    set(cx + dx, cy + dy, std::max(std::abs(dx), std::abs(dy)) != 1);
+                }
+            }
+        }
+    }
+
+    // Format information areas, filled per mask, and the dark module.
+    for (int i = 0; i < 9; ++i)
+    {
+        m_isFunction[8 * width + i] = 1;
+        m_isFunction[i * width + 8] = 1;
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        m_isFunction[8 * width + width - 1 - i] = 1;
+        m_isFunction[(width - 1 - i) * width + 8] = 1;
+    }
+    set(8, width - 8, true);
+
+    if (m_version >= 7)
+    {
+        const uint32_t info = QR_VERSION_INFO[m_version];
+        for (int i = 0; i < 18; ++i)
+        {
+            const bool bit = (info >> i) & 1;
+            set(i / 3, width - 11 + i % 3, bit);
+            set(width - 11 + i % 3, i / 3, bit);
+        }
+    }
+
+    for (int mask = 0; mask < 8; ++mask)
+    {
+        auto& plane = m_maskPlanes[mask];
+        plane.resize(area);
+        for (int y = 0; y < width; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                plane[y * width + x] = !m_isFunction[y * width + x] && IsMasked(mask, x, y);
+            }
+        }
+    }
+    m_packedPlanes.resize(8);
+    for (int mask = 0; mask < 8; ++mask)
+    {
+        PackQrModules(m_maskPlanes[mask].data(), width, m_packedPlanes[mask]);
+    }
+    m_patternVersion = m_version;
+}
+
+void QrEncoder::PlaceCodewords()
+{
+    // Data modules are placed in two-module wide columns from the bottom right, alternately
+    // upwards and downwards, skipping the vertical timing pattern. Remainder modules stay light.
+    const int width = m_width;
+    const size_t numBits = 8 * m_interleaved.size();
+    size_t i = 0;
+    for (int right = width - 1; right >= 1; right -= 2)
+    {
+        if (right == 6)
+        {
+            right = 5;
+        }
+        const bool isUpward = ((right + 1) & 2) == 0;
+        for (int step = 0; step < width; ++step)
+        {
+            const int y = isUpward ? width - 1 - step : step;
+            for (int j = 0; j < 2; ++j)
+            {
+                const int index = y * width + right - j;
+                if (m_isFunction[index])
+                {
+                    continue;
+                }
+                m_unmasked[index] = i < numBits ? (m_interleaved[i >> 3] >> (7 - (i & 7))) & 1 : 0;
+                ++i;
+            }
+        }
+    }
+}
+
+int QrEncoder::SelectMask(const bool isFast)
+{
+    PackQrModules(m_unmasked.data(), m_width, m_packedUnmasked);
+    const int numRows = 64 * ((m_width + 63) / 64);
+    int bestMask = 0;
+    int bestPenalty = INT_MAX;
+    for (int mask = 0; mask < 8; ++mask)
+    {
+        const auto& plane = m_packedPlanes[mask];
+        for (int y = 0; y < numRows; ++y)
+        {
+            for (int w = 0; w < QR_PACKED_WORDS; ++w)
+            {
+                m_candidate[y][w] = m_packedUnmasked[y][w] ^ plane[y][w];
+            }
+        }
+        ForEachFormatModule(m_width, QR_FORMAT_INFO[m_level][mask], [this](const int x, const int y, const bool bit)
+        {
+            m_candidate[y][x >> 6] |= uint64_t(bit) << (x & 63);
+        });
+        const int penalty = GetQrMaskPenalty(m_candidate, m_width, isFast);
+        if (penalty < bestPenalty)
+        {
+            bestPenalty = penalty;
+            bestMask = mask;
+        }
+    }
+    return bestMask;
+}
+
+void QrEncoder::ApplyMask(const int mask, const QRecLevel level, uint8_t* modules) const
+{
+    const size_t area = static_cast<size_t>(m_width) * m_width;
+    const uint8_t* plane = m_maskPlanes[mask].data();
+    for (size_t i = 0; i < area; ++i)
+    {
+        modules[i] = m_unmasked[i] ^ plane[i];
+    }
+
+    const int width = m_width;
+    ForEachFormatModule(width, QR_FORMAT_INFO[level][mask], [modules, width](const int x, const int y, const bool bit)
+    {
+        modules[y * width + x] = bit;
+    });
+}
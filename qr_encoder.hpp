@@ -0,0 +1,242 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <qrencode.h>
+
+#include "qr_capacity.hpp"
+#include "qur.hpp"
+#include "reed_solomon.hpp"
+
+/// Largest number of modules along one side of a QR code.
+constexpr int QR_MAX_WIDTH = GetQrWidth(QR_MAX_VERSION);
+
+/// Number of 64-bit words of a bit-packed row.
+constexpr int QR_PACKED_WORDS = (QR_MAX_WIDTH + 63) / 64;
+
+/**
+ *  \brief  Modules of a symbol with one bit per module.
+ *
+ *  Module x of row y is bit x % 64 of word x / 64 of row y. Modules outside the symbol are zero.
+ *  The number of rows is rounded up to whole 64 x 64 blocks for the transposition.
+ */
+using QrPackedModules = std::array<std::array<uint64_t, QR_PACKED_WORDS>, 64 * QR_PACKED_WORDS>;
+
+/**
+ *  \brief  Computes the 15-bit format information of all EC levels and masks.
+ *
+ *  The table is indexed by QRecLevel and mask. It holds the BCH(15,5) code of the level and the
+ *  mask, XORed with 0x5412.
+ */
+constexpr auto MakeFormatInfo()
+{
+    std::array<std::array<uint16_t, 8>, 4> table{};
+    // Indicator bits of QR_ECLEVEL_L, M, Q and H.
+    constexpr int LEVEL_BITS[4] = {1, 0, 3, 2};
+    for (int level = 0; level < 4; ++level)
+    {
+        for (int mask = 0; mask < 8; ++mask)
+        {
+            const int data = LEVEL_BITS[level] << 3 | mask;
+            int remainder = data;
+            for (int i = 0; i < 10; ++i)
+            {
+                remainder = (remainder << 1) ^ ((remainder >> 9) * 0x537);
+            }
+            table[level][mask] = static_cast<uint16_t>((data << 10 | remainder) ^ 0x5412);
+        }
+    }
+    return table;
+}
+
+/// Format information indexed by QRecLevel and mask.
+constexpr auto QR_FORMAT_INFO = MakeFormatInfo();
+
+static_assert(QR_FORMAT_INFO[QR_ECLEVEL_M][0] == 0x5412 && QR_FORMAT_INFO[QR_ECLEVEL_L][0] == 0x77c4 && QR_FORMAT_INFO[QR_ECLEVEL_L][4] == 0x662f, "QR format information mismatch");
+
+/**
+ *  \brief  Computes the 18-bit version information of versions 7 and above.
+ */
+constexpr auto MakeVersionInfo()
+{
+    std::array<uint32_t, QR_MAX_VERSION + 1> table{};
+    for (int version = 7; version <= QR_MAX_VERSION; ++version)
+    {
+        int remainder = version;
+        for (int i = 0; i < 12; ++i)
+        {
+            remainder = (remainder << 1) ^ ((remainder >> 11) * 0x1f25);
+        }
+        table[version] = static_cast<uint32_t>(version << 12 | remainder);
+    }
+    return table;
+}
+
+/// Version information indexed by version, 0 below version 7.
+constexpr auto QR_VERSION_INFO = MakeVersionInfo();
+
+static_assert(QR_VERSION_INFO[7] == 0x07c94 && QR_VERSION_INFO[40] == 0x28c69, "QR version information mismatch");
+
+/**
+ *  \brief  Returns the number of alignment pattern coordinates along one axis.
+ */
+constexpr int GetQrNumAlignmentPositions(const int version)
+{
+    return version == 1 ? 0 : version / 7 + 2;
+}
+
+/**
+ *  \brief  Returns the i-th alignment pattern coordinate along one axis.
+ */
+constexpr int GetQrAlignmentPosition(const int version, const int i)
+{
+    const int numAlign = GetQrNumAlignmentPositions(version);
+    const int step = version == 32 ? 26 : (version * 4 + numAlign * 2 + 1) / (numAlign * 2 - 2) * 2;
+    return i == 0 ? 6 : GetQrWidth(version) - 7 - (numAlign - 1 - i) * step;
+}
+
+static_assert(GetQrAlignmentPosition(7, 1) == 22 && GetQrAlignmentPosition(32, 1) == 34 && GetQrAlignmentPosition(40, 6) == 170, "QR alignment pattern mismatch");
+
+/**
+ *  \brief  Single segment QR encoder for UR strings.
+ *
+ *  UR strings are encoded as one byte or alphanumeric segment in the smallest version that fits,
+ *  like libqrencode does, and the mask is chosen with the penalty rules of libqrencode, so the
+ *  symbols are identical. If the options set a version, that version is used; strings that do
+ *  not fit are rejected. All intermediate results are kept in buffers that are reused by the
+ *  following calls; the function patterns and mask planes of the last version are cached. An
+ *  encoder is not thread safe, use one per thread.
+ */
+class QrEncoder
+{
+public:
+    /**
+     *  \brief  Encodes a UR string.
+     *
+     *  Throws std::invalid_argument if the string does not fit a QR code of the requested version
+     *  or contains characters outside the alphanumeric set in alphanumeric mode.
+     *
+     *  \param  ur  UR string.
+     *  \param  options Encoding mode, error correction level, version and mask policy. The backend
+     *                  is ignored.
+     *  \param  mask    Mask pattern between 0 and 7 that overrides the mask policy, or -1.
+     *  \returns    QR code whose data point into the encoder and stay valid until the next call.
+     *              Like in libqrencode, bit 0 of a module is set for dark modules.
+     */
+    QRcode Encode(const std::string& ur, const QrOptions& options, const int mask = -1);
+
+private:
+    void EncodeData(const std::string& ur, const QrOptions& options);
+    void AddErrorCorrection();
+    void PreparePatterns();
+    void PlaceCodewords();
+    void ApplyMask(const int mask, const QRecLevel level, uint8_t* modules) const;
+    int SelectMask(const bool isFast);
+
+    int m_version = 0;
+    int m_width = 0;
+    QRecLevel m_level = QR_ECLEVEL_L;
+    /// Version of the cached function patterns and mask planes.
+    int m_patternVersion = 0;
+    /// Data codewords followed by the error correction codewords of each block.
+    std::vector<uint8_t> m_codewords;
+    /// Codewords in the order of placement.
+    std::vector<uint8_t> m_interleaved;
+    /// Non-zero for function modules.
+    std::vector<uint8_t> m_isFunction;
+    /// Function patterns without the format information, with data modules placed.
+    std::vector<uint8_t> m_unmasked;
+    /// Mask patterns restricted to the data modules.
+    std::array<std::vector<uint8_t>, 8> m_maskPlanes;
+    /// Bit-packed mask planes of m_maskPlanes.
+    std::vector<QrPackedModules> m_packedPlanes;
+    /// Bit-packed m_unmasked.
+    QrPackedModules m_packedUnmasked;
+    /// Bit-packed masked symbol under evaluation.
+    QrPackedModules m_candidate;
+    /// Masked symbol returned to the caller.
+    std::vector<uint8_t> m_modules;
+};
+
+/**
+ *  \brief  Returns the Reed-Solomon block layout of a QR version and EC level.
+ */
+RsBlockLayout GetQrBlockLayout(const int version, const QRecLevel level);
+
+/**
+ *  \brief  Returns the mask pattern of a QR code, read from its format information.
+ */
+int GetQrMask(const QRcode* qur);
+
+/**
+ *  \brief  Parses a mask policy.
+ *
+ *  Throws std::invalid_argument on unknown policies.
+ *
+ *  \param  spec    "full", "fast" or a fixed mask pattern between 0 and 7.
+ *  \param  options Options whose maskPolicy and fixedMask are set.
+ */
+void ParseQrMaskPolicy(const std::string& spec, QrOptions& options);
+
+/**
+ *  \brief  Returns the name of the mask policy of options, as accepted by ParseQrMaskPolicy.
+ */
+std::string GetQrMaskPolicyName(const QrOptions& options);
+
+/**
+ *  \brief  Packs the modules of a symbol into bits.
+ *
+ *  \param  modules Modules in row-major order, bit 0 set for dark modules.
+ *  \param  width   Number of modules along one side.
+ *  \param  packed  Output.
+ */
+void PackQrModules(const uint8_t* modules, const int width, QrPackedModules& packed);
+
+/**
+ *  \brief  Computes the mask penalty of a symbol the way libqrencode does.
+ *
+ *  The rules are those of ISO/IEC 18004 with libqrencode's reading of the finder-like pattern
+ *  rule, which also matches scaled patterns and treats the symbol border as light.
+ *
+ *  \param  modules Modules in row-major order, bit 0 set for dark modules.
+ *  \param  width   Number of modules along one side.
+ *  \returns    Penalty score.
+ */
+int GetQrMaskPenalty(const uint8_t* modules, const int width);
+
+/**
+ *  \brief  Computes the same penalty as GetQrMaskPenalty from bit-packed modules.
+ *
+ *  The 2 x 2 blocks and the dark modules are counted 64 modules at a time, runs are found from
+ *  the bits that differ from their neighbours and the columns are scored as the rows of the
+ *  transposed symbol.
+ *
+ *  \param  modules Bit-packed modules.
+ *  \param  width   Number of modules along one side.
+ *  \param  isRowsOnly  Skip the runs and finder-like patterns of the columns, which saves the
+ *                      transposition. This is the penalty of the Fast mask policy.
+ *  \returns    Penalty score.
+ */
+int GetQrMaskPenalty(const QrPackedModules& modules, const int width, const bool isRowsOnly = false);
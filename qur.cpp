@@ -0,0 +1,311 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qur.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <opencv2/imgproc.hpp>
+
+#include <bc-ur/ur-encoder.hpp>
+
+#include <lifehash.hpp>
+
+ur::ByteVector MakeMessage(const size_t len, const uint32_t seed)
+{
+    auto rng = ur::Xoshiro256(seed);
+    return rng.next_data(len);
+}
+
+static const std::string MESSAGE_UR_TYPE = "bytes";
+
+ur::UR MakeMessageUr(const size_t len, const uint32_t seed)
+{
+    const auto message = MakeMessage(len, seed);
+    ur::ByteVector cbor;
+    ur::CborLite::encodeBytes(cbor, message);
+    return ur::UR(MESSAGE_UR_TYPE, cbor);
+}
+
+/**
+ *  \brief  Returns the length of a CBOR header that encodes an unsigned integer or a byte string length.
+ */
+static size_t GetCborHeaderLength(const uint64_t value)
+{
+    return value < 24 ? 1 : (value <= 0xff ? 2 : (value <= 0xffff ? 3 : (value <= 0xffffffff ? 5 : 9)));
+}
+
+size_t GetMessageUrCborLength(const size_t len)
+{
+    return GetCborHeaderLength(len) + len;
+}
+
+size_t GetMinMultiPartMessageLength()
+{
+    size_t len = 1;
+    while (GetMessageUrCborLength(len) < UR_MIN_FRAGMENT_LENGTH)
+    {
+        ++len;
+    }
+    return len;
+}
+
+size_t GetSinglePartUrLength(const size_t cborLength)
+{
+    // "ur:<type>/" followed by minimal bytewords (two letters per byte) of the payload and its CRC32.
+    return 4 + MESSAGE_UR_TYPE.size() + 2 * (cborLength + 4);
+}
+
+/**
+ *  \brief  Returns the fragment length ur::UREncoder chooses for a maximum fragment length.
+ */
+static size_t GetNominalFragmentLength(const size_t cborLength, const size_t maxFragmentLen)
+{
+    size_t fragmentLen = cborLength;
+    for (size_t count = 1; count <= cborLength / UR_MIN_FRAGMENT_LENGTH; ++count)
+    {
+        fragmentLen = (cborLength + count - 1) / count;
+        if (fragmentLen <= maxFragmentLen)
+        {
+            break;
+        }
+    }
+    return fragmentLen;
+}
+
+size_t GetMultiPartSeqLength(const size_t cborLength, const size_t maxFragmentLen)
+{
+    const size_t fragmentLen = GetNominalFragmentLength(cborLength, maxFragmentLen);
+    return (cborLength + fragmentLen - 1) / fragmentLen;
+}
+
+size_t GetMultiPartUrLength(const size_t cborLength, const size_t maxFragmentLen, const size_t maxSeqNum)
+{
+    const size_t fragmentLen = GetNominalFragmentLength(cborLength, maxFragmentLen);
+    const size_t seqLen = (cborLength + fragmentLen - 1) / fragmentLen;
+    // Part CBOR: [seqNum, seqLen, messageLen, checksum, fragment] with a 32-bit checksum.
+    const size_t partLength = 1 + GetCborHeaderLength(maxSeqNum) + GetCborHeaderLength(seqLen)
+        + GetCborHeaderLength(cborLength) + GetCborHeaderLength(0xffffffff) + GetCborHeaderLength(fragmentLen) + fragmentLen;
+    // "ur:<type>/<seqNum>-<seqLen>/" followed by minimal bytewords of the part and its CRC32.
+    return 4 + MESSAGE_UR_TYPE.size() + std::to_string(maxSeqNum).size() + 1 + std::to_string(seqLen).size() + 1 + 2 * (partLength + 4);
+}
+
+size_t FindMaxFragmentLength(const size_t cborLength, const size_t capacity, const size_t numExtraParts)
+{
+    for (size_t fragmentLen = std::min(cborLength, capacity / 2); fragmentLen >= UR_MIN_FRAGMENT_LENGTH; --fragmentLen)
+    {
+        const size_t nominalLen = GetNominalFragmentLength(cborLength, fragmentLen);
+        const size_t seqLen = (cborLength + nominalLen - 1) / nominalLen;
+        const size_t maxSeqNum = numExtraParts == SIZE_MAX ? 0xffffffff : seqLen + numExtraParts;
+        if (GetMultiPartUrLength(cborLength, fragmentLen, maxSeqNum) <= capacity)
+        {
+            return fragmentLen;
+        }
+    }
+    return 0;
+}
+
+std::string GenerateSinglePartUr(const ur::UR& message)
+{
+    return ur::UREncoder::encode(message);
+}
+
+std::vector<std::string> GenerateMultiPartUr(const ur::UR& message, const size_t maxFragmentLen, const size_t numExtraParts)
+{
+    auto encoder = ur::UREncoder(message, maxFragmentLen);
+
+    std::vector<std::string> result;
+    for (size_t i = 0; i < encoder.seq_len() + numExtraParts; ++i)
+    {
+        result.emplace_back(encoder.next_part());
+    }
+    return result;
+}
+
+cv::Mat CreateLifeHashImage(const ur::UR& message, const int size)
+{
+    const auto lifeHash = LifeHash::make_from_data(message.cbor());
+    cv::Mat lifeHashImage(cv::Size(lifeHash.width, lifeHash.height), CV_8UC3);
+    for (size_t r = 0; r < lifeHashImage.rows; ++r)
+    {
+        for (size_t c = 0; c <lifeHashImage.cols; ++c)
+        {
+            const auto i = 3 * (r * lifeHash.width + c);
+            lifeHashImage.at<cv::Vec3b>(r, c) = cv::Vec3b(lifeHash.colors[i+2], lifeHash.colors[i+1], lifeHash.colors[i]);
+        }
+    }
+    cv::resize(lifeHashImage, lifeHashImage, cv::Size(size, size), 0, 0, cv::INTER_NEAREST);
+    return lifeHashImage;
+}
+
+QRencodeMode GetQrencodeMode(const QrEncodingMode mode)
+{
+    return mode == QrEncodingMode::Alphanumeric ? QR_MODE_AN : QR_MODE_8;
+}
+
+/**
+ *  \brief  Encodes a string as a single alphanumeric segment.
+ *
+ *  UR strings consist of letters, digits and the ':', '/' and '-' characters, which are all in
+ *  the QR alphanumeric set once the letters are uppercased.
+ */
+static QRcode* EncodeAlphanumeric(const std::string& ur, const int version, const QRecLevel level)
+{
+    std::string upper(ur);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](const unsigned char c){ return std::toupper(c); });
+
+    std::unique_ptr<QRinput, decltype(&QRinput_free)> input(QRinput_new2(version, level), &QRinput_free);
+    if (!input || QRinput_append(input.get(), QR_MODE_AN, static_cast<int>(upper.size()), reinterpret_cast<const unsigned char*>(upper.data())) != 0)
+    {
+        return nullptr;
+    }
+    return QRcode_encodeInput(input.get());
+}
+
+/**
+ *  \brief  Encodes a string as a Micro QR code.
+ *
+ *  libqrencode does not take single alphanumeric segments for Micro QR, so the uppercased string
+ *  goes through its segment splitter, which picks the alphanumeric and numeric modes.
+ */
+static QRcode* EncodeMicro(const std::string& ur, const QrOptions& options)
+{
+    if (options.mode == QrEncodingMode::Alphanumeric)
+    {
+        std::string upper(ur);
+        std::transform(upper.begin(), upper.end(), upper.begin(), [](const unsigned char c){ return std::toupper(c); });
+        return QRcode_encodeStringMQR(upper.c_str(), options.version, options.ecLevel, QR_MODE_8, 1);
+    }
+    return QRcode_encodeString8bitMQR(ur.c_str(), options.version, options.ecLevel);
+}
+
+QrCodePtr EncodeQr(const std::string& ur, const QrOptions& options)
+{
+    QrCodePtr qur;
+    if (options.isMicro)
+    {
+        qur.reset(EncodeMicro(ur, options));
+    }
+    else
+    {
+        qur.reset(options.mode == QrEncodingMode::Alphanumeric
+            ? EncodeAlphanumeric(ur, options.version, options.ecLevel)
+            : QRcode_encodeString8bit(ur.c_str(), options.version, options.ecLevel));
+    }
+    if (!qur)
+    {
+        throw std::system_error(errno, std::generic_category(), "Cannot encode QR code");
+    }
+    // libqrencode treats the version as a minimum and silently moves on to larger ones.
+    if (options.version > 0 && qur->version != options.version)
+    {
+        throw std::invalid_argument("UR string of " + std::to_string(ur.size()) + " characters does not fit QR version " + std::to_string(options.version));
+    }
+    return qur;
+}
+
+cv::Mat RasterizeQrResize(const QRcode* qur, const int size)
+{
+    cv::Mat qurImage(qur->width, qur->width, CV_8U);
+    for (int r = 0; r < qurImage.rows; ++r)
+    {
+        for (int c = 0; c < qurImage.cols; ++c)
+        {
+            qurImage.at<uchar>(r, c) = (*(qur->data + r * qurImage.rows + c) % 2 == 1) ? 0 : 255;
+        }
+    }
+    cv::resize(qurImage, qurImage, cv::Size(size, size), 0, 0, cv::INTER_NEAREST);
+    cv::cvtColor(qurImage, qurImage, cv::COLOR_GRAY2BGR);
+    return qurImage;
+}
+
+void RasterizeQr(const QRcode* qur, const int size, cv::Mat& target)
+{
+    if (size < qur->width)
+    {
+        throw std::runtime_error("QR image size " + std::to_string(size) + "px is smaller than the QR code width of " + std::to_string(qur->width) + " modules");
+    }
+
+    target.create(size, size, CV_8UC3);
+
+    const int modulePx = size / qur->width;
+    const int offset = (size - modulePx * qur->width) / 2;
+    const size_t rowBytes = 3 * static_cast<size_t>(size);
+
+    for (int r = 0; r < offset; ++r)
+    {
+        std::memset(target.ptr(r), 255, rowBytes);
+    }
+
+    for (int mr = 0; mr < qur->width; ++mr)
+    {
+        const unsigned char* modules = qur->data + mr * qur->width;
+        const int firstRow = offset + mr * modulePx;
+        uchar* scanline = target.ptr(firstRow);
+        std::memset(scanline, 255, rowBytes);
+        for (int mc = 0; mc < qur->width; ++mc)
+        {
+            if (modules[mc] & 1)
+            {
+                std::memset(scanline + 3 * (offset + mc * modulePx), 0, 3 * modulePx);
+            }
+        }
+        for (int r = firstRow + 1; r < firstRow + modulePx; ++r)
+        {
+            std::memcpy(target.ptr(r), scanline, rowBytes);
+        }
+    }
+
+    for (int r = offset + modulePx * qur->width; r < size; ++r)
+    {
+        std::memset(target.ptr(r), 255, rowBytes);
+    }
+}
+
+static const int FRAME_MARGIN = 10;
+
+cv::Size GetFrameSize(const cv::Mat& lifeHashImage, const int qrSize)
+{
+    const int size = std::max(lifeHashImage.cols, qrSize);
+    return cv::Size(2*FRAME_MARGIN + size, 3*FRAME_MARGIN + lifeHashImage.rows + size);
+}
+
+cv::Mat PrepareFrame(const cv::Mat& lifeHashImage, const int qrSize, cv::Mat& frame)
+{
+    frame.create(GetFrameSize(lifeHashImage, qrSize), CV_8UC3);
+    frame.setTo(cv::Scalar(255, 255, 255));
+
+    const cv::Rect lifeHashRoi((frame.cols - lifeHashImage.cols) >> 1, FRAME_MARGIN, lifeHashImage.cols, lifeHashImage.rows);
+    lifeHashImage.copyTo(frame(lifeHashRoi));
+
+    const cv::Rect qurImageRoi((frame.cols - qrSize) >> 1, 2*FRAME_MARGIN + lifeHashImage.rows, qrSize, qrSize);
+    return frame(qurImageRoi);
+}
+
+void ComposeFrame(const cv::Mat& lifeHashImage, const QRcode* qur, const int qrSize, cv::Mat& frame)
+{
+    cv::Mat qurImage = PrepareFrame(lifeHashImage, qrSize, frame);
+    RasterizeQr(qur, qrSize, qurImage);
+}
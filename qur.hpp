@@ -0,0 +1,256 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <qrencode.h>
+
+#include <bc-ur/bc-ur.hpp>
+
+/**
+ *  \brief  Releases QR codes allocated by libqrencode.
+ */
+struct QrCodeDeleter
+{
+    void operator()(QRcode* qur) const
+    {
+        QRcode_free(qur);
+    }
+};
+
+/// Owning pointer to a libqrencode QR code.
+using QrCodePtr = std::unique_ptr<QRcode, QrCodeDeleter>;
+
+/**
+ *  \brief  QR data encoding mode of UR strings.
+ */
+enum class QrEncodingMode
+{
+    /// 8-bit byte mode, the UR string is encoded as is.
+    Byte,
+    /// Alphanumeric mode, the UR string is uppercased first.
+    Alphanumeric,
+};
+
+/**
+ *  \brief  Implementation of the QR encoder.
+ */
+enum class QrEncoderBackend
+{
+    /// libqrencode.
+    Libqrencode,
+    /// The in-tree single segment encoder of qr_encoder.hpp.
+    InTree,
+};
+
+/**
+ *  \brief  Mask selection of the in-tree QR encoder.
+ */
+enum class QrMaskPolicy
+{
+    /// Score all eight masks with the four penalty rules, as the standard and libqrencode do.
+    Full,
+    /// Score all eight masks with the penalty rules applied to the rows only.
+    Fast,
+    /// Use a given mask without scoring.
+    Fixed,
+};
+
+/**
+ *  \brief  Settings of the QR encoder.
+ */
+struct QrOptions
+{
+    /// Encoder implementation.
+    QrEncoderBackend backend = QrEncoderBackend::Libqrencode;
+    /// Data encoding mode.
+    QrEncodingMode mode = QrEncodingMode::Byte;
+    /// Error correction level.
+    QRecLevel ecLevel = QR_ECLEVEL_L;
+    /// Encode Micro QR codes (M1 to M4) instead of QR codes. They hold single part URs of tiny messages only.
+    bool isMicro = false;
+    /// Version of all QR codes, padded as needed, or 0 for the smallest version that fits each string.
+    int version = 0;
+    /// Mask selection, only the in-tree encoder supports other policies than Full.
+    QrMaskPolicy maskPolicy = QrMaskPolicy::Full;
+    /// Mask pattern of the Fixed policy, between 0 and 7.
+    int fixedMask = 0;
+};
+
+/**
+ *  \brief  Returns the libqrencode mode that corresponds to an encoding mode.
+ */
+QRencodeMode GetQrencodeMode(const QrEncodingMode mode);
+
+/**
+ *  \brief  Generates a random message with a given length.
+ *  \param  len Length of a generated message in bytes.
+ *  \param  seed    Seed of the random generator. Equal seeds give equal messages.
+ *  \returns    Generated message.
+ */
+ur::ByteVector MakeMessage(const size_t len, const uint32_t seed);
+
+/**
+ *  \brief  Generates a random message with a given length and stores it as a UR object.
+ *  \param  len Lengths of a generated message in bytes.
+ *  \param  seed    Seed of the random generator. Equal seeds give equal messages.
+ *  \returns    UR object that containt the generated message.
+ */
+ur::UR MakeMessageUr(const size_t len, const uint32_t seed);
+
+/// Minimum fragment length used by ur::UREncoder. Shorter CBOR payloads cannot be split into parts.
+constexpr size_t UR_MIN_FRAGMENT_LENGTH = 10;
+
+/**
+ *  \brief  Returns the smallest message length whose multi-part UR can be created.
+ */
+size_t GetMinMultiPartMessageLength();
+
+/**
+ *  \brief  Returns the length of the CBOR payload of a message created by MakeMessageUr().
+ *  \param  len Length of a generated message in bytes.
+ */
+size_t GetMessageUrCborLength(const size_t len);
+
+/**
+ *  \brief  Returns the length of the single part UR string of a message created by MakeMessageUr().
+ *  \param  cborLength  Length of the CBOR payload of the message.
+ */
+size_t GetSinglePartUrLength(const size_t cborLength);
+
+/**
+ *  \brief  Returns an upper bound of the length of the multi-part UR strings of a message created by MakeMessageUr().
+ *  \param  cborLength  Length of the CBOR payload of the message.
+ *  \param  maxFragmentLen  Maximum length of a fragment in bytes.
+ *  \param  maxSeqNum   Largest sequence number of a generated part.
+ */
+size_t GetMultiPartUrLength(const size_t cborLength, const size_t maxFragmentLen, const size_t maxSeqNum);
+
+/**
+ *  \brief  Returns the number of pure parts of a multi-part UR.
+ *  \param  cborLength  Length of the CBOR payload in bytes.
+ *  \param  maxFragmentLen  Maximum fragment length in bytes.
+ */
+size_t GetMultiPartSeqLength(const size_t cborLength, const size_t maxFragmentLen);
+
+/**
+ *  \brief  Finds the largest fragment length whose multi-part UR strings fit a given number of characters.
+ *  \param  cborLength  Length of the CBOR payload of the message.
+ *  \param  capacity    Maximum length of a UR string.
+ *  \param  numExtraParts   Number of extra fragments, or SIZE_MAX for an unbounded fountain.
+ *  \returns    Maximum fragment length in bytes, or 0 if not even the shortest fragment fits.
+ */
+size_t FindMaxFragmentLength(const size_t cborLength, const size_t capacity, const size_t numExtraParts);
+
+/**
+ *  \brief  Encodes the given message as a single part UR.
+ *  \param  message A message that will be encoded.
+ *  \returns    UR encoded string.
+ */
+std::string GenerateSinglePartUr(const ur::UR& message);
+
+/**
+ *  \brief  Encodes the given message as a multi-part UR.
+ *  \param  message A message that will be encoded.
+ *  \param  maxFragmentLen  Maximum length of a fragment in bytes.
+ *  \param  numExtraParts   Number of extra fragments.
+ *  \returns    UR encoded strings.
+ */
+std::vector<std::string> GenerateMultiPartUr(const ur::UR& message, const size_t maxFragmentLen, const size_t numExtraParts = 0);
+
+/**
+ *  \brief  Creates a lifehash image of a given message.
+ *  \param  message Message whose lifehash image will be computed.
+ *  \param  size    Size of the created lifehash image.
+ *  \returns    Lifehash image.
+ */
+cv::Mat CreateLifeHashImage(const ur::UR& message, const int size);
+
+/**
+ *  \brief  Encodes a UR string as a QR code.
+ *
+ *  The version set in the options, or else the smallest one that fits the string, is used. Throws
+ *  if the string does not fit.
+ *
+ *  \param  ur  UR encoded string.
+ *  \param  options QR encoder settings.
+ *  \returns    QR code.
+ */
+QrCodePtr EncodeQr(const std::string& ur, const QrOptions& options);
+
+/**
+ *  \brief  Rasterizes a QR code by upscaling a module image (reference implementation).
+ *
+ *  Kept to benchmark RasterizeQr() against. The QR code is stretched to the target size, so the
+ *  module pitch is not necessarily an integer.
+ *
+ *  \param  qur QR code to rasterize.
+ *  \param  size    Size of the created QR image.
+ *  \returns    BGR QR image.
+ */
+cv::Mat RasterizeQrResize(const QRcode* qur, const int size);
+
+/**
+ *  \brief  Rasterizes a QR code directly into a BGR image.
+ *
+ *  Every module is drawn as a square of an integer number of pixels, the symbol is centered and
+ *  the remaining border is white. One scanline is built per module row and then copied to all
+ *  pixel rows of that module row.
+ *
+ *  \param  qur QR code to rasterize.
+ *  \param  size    Size of the created QR image.
+ *  \param  target  Output image. It is (re)allocated only if its size or type differs.
+ */
+void RasterizeQr(const QRcode* qur, const int size, cv::Mat& target);
+
+/**
+ *  \brief  Computes the size of a frame that shows a lifehash image above a QR image.
+ *  \param  lifeHashImage   A lifehash image of a message.
+ *  \param  qrSize  Size of the QR image in pixels.
+ *  \returns    Frame size.
+ */
+cv::Size GetFrameSize(const cv::Mat& lifeHashImage, const int qrSize);
+
+/**
+ *  \brief  Draws the background and the lifehash image of a frame.
+ *  \param  lifeHashImage   A lifehash image of a message.
+ *  \param  qrSize  Size of the QR image in pixels.
+ *  \param  frame   Output frame. It is (re)allocated only if its size or type differs.
+ *  \returns    The area of the frame reserved for the QR image.
+ */
+cv::Mat PrepareFrame(const cv::Mat& lifeHashImage, const int qrSize, cv::Mat& frame);
+
+/**
+ *  \brief  Composes a single frame with the lifehash image above the QR image.
+ *
+ *  The QR code is rasterized directly into the frame.
+ *
+ *  \param  lifeHashImage   A lifehash image of a message.
+ *  \param  qur A QR code that contains one UR encoded string.
+ *  \param  qrSize  Size of the QR image in pixels.
+ *  \param  frame   Output frame. It is (re)allocated only if its size or type differs.
+ */
+void ComposeFrame(const cv::Mat& lifeHashImage, const QRcode* qur, const int qrSize, cv::Mat& frame);
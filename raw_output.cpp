@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "raw_output.hpp"
+
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+RawFormat ParseRawFormat(const std::string& name)
+{
+    if (name == "y4m")
+    {
+        return RawFormat::Y4m;
+    }
+    if (name == "y4m-mono")
+    {
+        return RawFormat::Y4mMono;
+    }
+    if (name == "gray")
+    {
+        return RawFormat::Gray;
+    }
+    if (name == "bgr")
+    {
+        return RawFormat::Bgr;
+    }
+    throw std::invalid_argument("Unknown raw format " + name);
+}
+
+RawFrameWriter::RawFrameWriter(FILE* file, const RawFormat format, const double fps)
+    : m_file(file)
+    , m_format(format)
+    , m_fps(fps)
+{
+}
+
+bool RawFrameWriter::Write(const cv::Mat& frame)
+{
+    if (m_size.empty())
+    {
+        m_size = frame.size();
+        if (m_format == RawFormat::Y4m && (m_size.width % 2 != 0 || m_size.height % 2 != 0))
+        {
+            m_padded.create((m_size.height + 1) & ~1, (m_size.width + 1) & ~1, CV_8UC3);
+            m_padded.setTo(cv::Scalar::all(255));
+        }
+        if (!WriteHeader(m_padded.empty() ? m_size : m_padded.size()))
+        {
+            return false;
+        }
+    }
+    if (frame.size() != m_size)
+    {
+        throw std::invalid_argument("Frame size changed in a raw stream");
+    }
+
+    cv::Mat source = frame;
+    if (!m_padded.empty())
+    {
+        frame.copyTo(m_padded(cv::Rect(0, 0, m_size.width, m_size.height)));
+        source = m_padded;
+    }
+
+    static const char FRAME_HEADER[] = "FRAME\n";
+    switch (m_format)
+    {
+    case RawFormat::Y4m:
+        cv::cvtColor(source, m_buffer, cv::COLOR_BGR2YUV_I420);
+        if (!WriteBytes(FRAME_HEADER, sizeof(FRAME_HEADER) - 1))
+        {
+            return false;
+        }
+        break;
+    case RawFormat::Y4mMono:
+        cv::cvtColor(source, m_buffer, cv::COLOR_BGR2GRAY);
+        if (!WriteBytes(FRAME_HEADER, sizeof(FRAME_HEADER) - 1))
+        {
+            return false;
+        }
+        break;
+    case RawFormat::Gray:
+        cv::cvtColor(source, m_buffer, cv::COLOR_BGR2GRAY);
+        break;
+    case RawFormat::Bgr:
+        if (!source.isContinuous())
+        {
+            source.copyTo(m_buffer);
+            source = m_buffer;
+        }
+        return WriteBytes(source.data, source.total() * source.elemSize());
+    }
+    return WriteBytes(m_buffer.data, m_buffer.total() * m_buffer.elemSize());
+}
+
+bool RawFrameWriter::WriteHeader(const cv::Size& size)
+{
+    if (m_format != RawFormat::Y4m && m_format != RawFormat::Y4mMono)
+    {
+        return true;
+    }
+    // The frame rate is stored as a fraction with millisecond precision.
+    const long long denominator = 1000;
+    const long long numerator = std::llround(m_fps * denominator);
+    const long long divisor = std::gcd(numerator, denominator);
+
+    std::ostringstream header;
+    header << "YUV4MPEG2 W" << size.width << " H" << size.height
+        << " F" << numerator / divisor << ':' << denominator / divisor
+        << " Ip A1:1 " << (m_format == RawFormat::Y4m ? "C420jpeg" : "Cmono") << '\n';
+    const auto text = header.str();
+    return WriteBytes(text.data(), text.size());
+}
+
+bool RawFrameWriter::WriteBytes(const void* data, const size_t size)
+{
+    return std::fwrite(data, 1, size, m_file) == size;
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  \brief  Pixel formats of a raw frame stream.
+ */
+enum class RawFormat
+{
+    /// YUV4MPEG2 with 4:2:0 chroma, frames padded to even dimensions.
+    Y4m,
+    /// YUV4MPEG2 with the luma plane only.
+    Y4mMono,
+    /// Headerless 8-bit gray frames.
+    Gray,
+    /// Headerless 24-bit BGR frames.
+    Bgr,
+};
+
+/**
+ *  \brief  Parses a raw format name: y4m, y4m-mono, gray or bgr.
+ *
+ *  Throws std::invalid_argument on unknown names.
+ */
+RawFormat ParseRawFormat(const std::string& name);
+
+/**
+ *  \brief  Writes frames as a raw video stream, e.g. to stdout for ffmpeg.
+ *
+ *  The stream header is written with the first frame, whose size determines the size of all
+ *  frames. Conversions go through buffers that are allocated once and reused, so writing a frame
+ *  does not allocate.
+ */
+class RawFrameWriter
+{
+public:
+    /**
+     *  \brief  Creates a writer.
+     *  \param  file    Output file. It is not closed by the writer.
+     *  \param  format  Pixel format.
+     *  \param  fps Number of frames per second stored in the YUV4MPEG2 header.
+     */
+    RawFrameWriter(FILE* file, const RawFormat format, const double fps);
+
+    /**
+     *  \brief  Writes a frame.
+     *
+     *  Throws std::invalid_argument if the frame size differs from the first frame.
+     *
+     *  \param  frame   BGR frame.
+     *  \returns    False if the output is closed or cannot be written.
+     */
+    bool Write(const cv::Mat& frame);
+
+private:
+    bool WriteHeader(const cv::Size& size);
+    bool WriteBytes(const void* data, const size_t size);
+
+    FILE* const m_file;
+    const RawFormat m_format;
+    const double m_fps;
+    cv::Size m_size;
+    /// White frame of even size that odd-sized frames are copied into before the 4:2:0 conversion.
+    cv::Mat m_padded;
+    cv::Mat m_buffer;
+};
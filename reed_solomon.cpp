@@ -0,0 +1,287 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "reed_solomon.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUR_RS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/**
+ *  \brief  Generator polynomial of one degree, zero padded to a full AVX2 register.
+ */
+struct RsGenerator
+{
+    alignas(32) uint8_t coefficients[32];
+    /// Low nibbles of the coefficients.
+    alignas(32) uint8_t low[32];
+    /// High nibbles of the coefficients.
+    alignas(32) uint8_t high[32];
+    int eccLength;
+};
+
+/// Remainder of one block, zero padded to a full AVX2 register.
+struct alignas(32) RsRemainder
+{
+    uint8_t values[32];
+};
+
+/**
+ *  \brief  Encodes a block into a zero-initialized remainder.
+ */
+void EncodeBlockScalar(const uint8_t* data, const int length, const RsGenerator& generator, uint8_t* remainder)
+{
+    const int eccLength = generator.eccLength;
+    for (int i = 0; i < length; ++i)
+    {
+        const uint8_t factor = data[i] ^ remainder[0];
+        std::memmove(remainder, remainder + 1, eccLength - 1);
+        remainder[eccLength - 1] = 0;
+        if (factor != 0)
+        {
+            const int logFactor = QR_GF.log[factor];
+            for (int j = 0; j < eccLength; ++j)
+            {
+                if (generator.coefficients[j] != 0)
+                {
+                    remainder[j] ^= QR_GF.exp[logFactor + QR_GF.log[generator.coefficients[j]]];
+                }
+            }
+        }
+    }
+}
+
+void EncodePairScalar(const uint8_t* dataA, const uint8_t* dataB, const int length, const RsGenerator& generator, RsRemainder& a, RsRemainder& b)
+{
+    EncodeBlockScalar(dataA, length, generator, a.values);
+    EncodeBlockScalar(dataB, length, generator, b.values);
+}
+
+#ifdef QUR_RS_X86
+
+/**
+ *  \brief  Computes the products of every element with all nibbles.
+ *
+ *  Row f holds f * k in the first and f * (k << 4) in the second half for k = 0..15, so the
+ *  product of f and x is the XOR of two 16-entry lookups by the nibbles of x.
+ */
+constexpr auto MakeNibbleProducts()
+{
+    std::array<std::array<uint8_t, 32>, 256> table{};
+    for (int f = 0; f < 256; ++f)
+    {
+        for (int k = 0; k < 16; ++k)
+        {
+            table[f][k] = GfMultiply(static_cast<uint8_t>(f), static_cast<uint8_t>(k));
+            table[f][16 + k] = GfMultiply(static_cast<uint8_t>(f), static_cast<uint8_t>(k << 4));
+        }
+    }
+    return table;
+}
+
+alignas(32) constexpr auto NIBBLE_PRODUCTS = MakeNibbleProducts();
+
+/**
+ *  \brief  Returns the generator multiplied by a factor, for the 16 coefficients of one register.
+ */
+__attribute__((target("ssse3")))
+inline __m128i MultiplySsse3(const __m128i lowTable, const __m128i highTable, const __m128i low, const __m128i high)
+{
+    return _mm_xor_si128(_mm_shuffle_epi8(lowTable, low), _mm_shuffle_epi8(highTable, high));
+}
+
+__attribute__((target("ssse3")))
+void EncodePairSsse3(const uint8_t* dataA, const uint8_t* dataB, const int length, const RsGenerator& generator, RsRemainder& a, RsRemainder& b)
+{
+    const auto low0 = _mm_load_si128(reinterpret_cast<const __m128i*>(generator.low));
+    const auto low1 = _mm_load_si128(reinterpret_cast<const __m128i*>(generator.low + 16));
+    const auto high0 = _mm_load_si128(reinterpret_cast<const __m128i*>(generator.high));
+    const auto high1 = _mm_load_si128(reinterpret_cast<const __m128i*>(generator.high + 16));
+    auto a0 = _mm_load_si128(reinterpret_cast<const __m128i*>(a.values));
+    auto a1 = _mm_load_si128(reinterpret_cast<const __m128i*>(a.values + 16));
+    auto b0 = _mm_load_si128(reinterpret_cast<const __m128i*>(b.values));
+    auto b1 = _mm_load_si128(reinterpret_cast<const __m128i*>(b.values + 16));
+    for (int i = 0; i < length; ++i)
+    {
+        const uint8_t factorA = dataA[i] ^ static_cast<uint8_t>(_mm_cvtsi128_si32(a0));
+        const uint8_t factorB = dataB[i] ^ static_cast<uint8_t>(_mm_cvtsi128_si32(b0));
+        a0 = _mm_alignr_epi8(a1, a0, 1);
+        a1 = _mm_srli_si128(a1, 1);
+        b0 = _mm_alignr_epi8(b1, b0, 1);
+        b1 = _mm_srli_si128(b1, 1);
+        const auto lowA = _mm_load_si128(reinterpret_cast<const __m128i*>(NIBBLE_PRODUCTS[factorA].data()));
+        const auto highA = _mm_load_si128(reinterpret_cast<const __m128i*>(NIBBLE_PRODUCTS[factorA].data() + 16));
+        const auto lowB = _mm_load_si128(reinterpret_cast<const __m128i*>(NIBBLE_PRODUCTS[factorB].data()));
+        const auto highB = _mm_load_si128(reinterpret_cast<const __m128i*>(NIBBLE_PRODUCTS[factorB].data() + 16));
+        a0 = _mm_xor_si128(a0, MultiplySsse3(lowA, highA, low0, high0));
+        a1 = _mm_xor_si128(a1, MultiplySsse3(lowA, highA, low1, high1));
+        b0 = _mm_xor_si128(b0, MultiplySsse3(lowB, highB, low0, high0));
+        b1 = _mm_xor_si128(b1, MultiplySsse3(lowB, highB, low1, high1));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(a.values), a0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(a.values + 16), a1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(b.values), b0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(b.values + 16), b1);
+}
+
+/**
+ *  \brief  Shifts a register down by one byte across both lanes.
+ */
+__attribute__((target("avx2")))
+inline __m256i ShiftDownAvx2(const __m256i value)
+{
+    return _mm256_alignr_epi8(_mm256_permute2x128_si256(value, value, 0x81), value, 1);
+}
+
+__attribute__((target("avx2")))
+inline __m256i LoadProductsAvx2(const uint8_t factor, const int offset)
+{
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(NIBBLE_PRODUCTS[factor].data() + offset)));
+}
+
+__attribute__((target("avx2")))
+void EncodePairAvx2(const uint8_t* dataA, const uint8_t* dataB, const int length, const RsGenerator& generator, RsRemainder& a, RsRemainder& b)
+{
+    const auto low = _mm256_load_si256(reinterpret_cast<const __m256i*>(generator.low));
+    const auto high = _mm256_load_si256(reinterpret_cast<const __m256i*>(generator.high));
+    auto remainderA = _mm256_load_si256(reinterpret_cast<const __m256i*>(a.values));
+    auto remainderB = _mm256_load_si256(reinterpret_cast<const __m256i*>(b.values));
+    for (int i = 0; i < length; ++i)
+    {
+        const uint8_t factorA = dataA[i] ^ static_cast<uint8_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(remainderA)));
+        const uint8_t factorB = dataB[i] ^ static_cast<uint8_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(remainderB)));
+        const auto productA = _mm256_xor_si256(_mm256_shuffle_epi8(LoadProductsAvx2(factorA, 0), low), _mm256_shuffle_epi8(LoadProductsAvx2(factorA, 16), high));
+        const auto productB = _mm256_xor_si256(_mm256_shuffle_epi8(LoadProductsAvx2(factorB, 0), low), _mm256_shuffle_epi8(LoadProductsAvx2(factorB, 16), high));
+        remainderA = _mm256_xor_si256(ShiftDownAvx2(remainderA), productA);
+        remainderB = _mm256_xor_si256(ShiftDownAvx2(remainderB), productB);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(a.values), remainderA);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(b.values), remainderB);
+}
+
+#endif
+
+}
+
+bool IsRsKernelSupported(const RsKernel kernel)
+{
+    switch (kernel)
+    {
+        case RsKernel::Scalar:
+            return true;
+#ifdef QUR_RS_X86
+        case RsKernel::Ssse3:
+            return __builtin_cpu_supports("ssse3");
+        case RsKernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+RsKernel GetBestRsKernel()
+{
+    static const RsKernel BEST = IsRsKernelSupported(RsKernel::Avx2) ? RsKernel::Avx2 : IsRsKernelSupported(RsKernel::Ssse3) ? RsKernel::Ssse3 : RsKernel::Scalar;
+    return BEST;
+}
+
+const char* GetRsKernelName(const RsKernel kernel)
+{
+    switch (kernel)
+    {
+        case RsKernel::Ssse3: return "ssse3";
+        case RsKernel::Avx2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+void EncodeRsBlocks(const uint8_t* data, const RsBlockLayout& layout, uint8_t* ecc, const RsKernel kernel)
+{
+    if (!IsRsKernelSupported(kernel))
+    {
+        throw std::invalid_argument(std::string("Reed-Solomon kernel ") + GetRsKernelName(kernel) + " is not supported by the CPU");
+    }
+    if (layout.eccLength < 1 || layout.eccLength > QR_MAX_ECC_CODEWORDS)
+    {
+        throw std::invalid_argument("Invalid number of error correction codewords");
+    }
+
+    auto encodePair = EncodePairScalar;
+#ifdef QUR_RS_X86
+    if (kernel == RsKernel::Ssse3)
+    {
+        encodePair = EncodePairSsse3;
+    }
+    else if (kernel == RsKernel::Avx2)
+    {
+        encodePair = EncodePairAvx2;
+    }
+#endif
+
+    RsGenerator generator{};
+    generator.eccLength = layout.eccLength;
+    for (int j = 0; j < layout.eccLength; ++j)
+    {
+        generator.coefficients[j] = QR_RS_GENERATORS[layout.eccLength][j];
+        generator.low[j] = generator.coefficients[j] & 0x0f;
+        generator.high[j] = generator.coefficients[j] >> 4;
+    }
+
+    // Blocks are encoded in pairs over the length of the shorter one; the last data codeword of a
+    // long block paired with a short one, and the block left over, are finished with the scalar code.
+    const int numBlocks = layout.numShortBlocks + layout.numLongBlocks;
+    const auto blockLength = [&layout](const int b)
+    {
+        return layout.shortDataLength + (b >= layout.numShortBlocks ? 1 : 0);
+    };
+    const auto blockOffset = [&layout](const int b)
+    {
+        return b * layout.shortDataLength + std::max(0, b - layout.numShortBlocks);
+    };
+    for (int b = 0; b < numBlocks; b += 2)
+    {
+        RsRemainder a{};
+        RsRemainder c{};
+        const uint8_t* dataA = data + blockOffset(b);
+        const int lengthA = blockLength(b);
+        int common = lengthA;
+        if (b + 1 < numBlocks)
+        {
+            common = std::min(lengthA, blockLength(b + 1));
+            encodePair(dataA, data + blockOffset(b + 1), common, generator, a, c);
+            EncodeBlockScalar(data + blockOffset(b + 1) + common, blockLength(b + 1) - common, generator, c.values);
+            std::copy(c.values, c.values + layout.eccLength, ecc + (b + 1) * layout.eccLength);
+        }
+        else
+        {
+            common = 0;
+        }
+        EncodeBlockScalar(dataA + common, lengthA - common, generator, a.values);
+        std::copy(a.values, a.values + layout.eccLength, ecc + b * layout.eccLength);
+    }
+}
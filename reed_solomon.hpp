@@ -0,0 +1,166 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/**
+ *  \brief  Arithmetic tables of GF(256) with the QR polynomial x^8 + x^4 + x^3 + x^2 + 1.
+ */
+struct GaloisTables
+{
+    /// Powers of the generator 2, doubled in length so that sums of two logarithms need no reduction.
+    std::array<uint8_t, 512> exp;
+    /// Discrete logarithms, log[0] is unused.
+    std::array<uint8_t, 256> log;
+};
+
+/**
+ *  \brief  Computes the GF(256) tables.
+ */
+constexpr GaloisTables MakeGaloisTables()
+{
+    GaloisTables tables{};
+    int x = 1;
+    for (int i = 0; i < 255; ++i)
+    {
+        tables.exp[i] = static_cast<uint8_t>(x);
+        tables.log[x] = static_cast<uint8_t>(i);
+        x <<= 1;
+        if (x & 0x100)
+        {
+            x ^= 0x11d;
+        }
+    }
+    for (int i = 255; i < 512; ++i)
+    {
+        tables.exp[i] = tables.exp[i - 255];
+    }
+    return tables;
+}
+
+/// GF(256) tables.
+constexpr GaloisTables QR_GF = MakeGaloisTables();
+
+/**
+ *  \brief  Multiplies two elements of GF(256).
+ */
+constexpr uint8_t GfMultiply(const uint8_t a, const uint8_t b)
+{
+    return a == 0 || b == 0 ? 0 : QR_GF.exp[QR_GF.log[a] + QR_GF.log[b]];
+}
+
+/// Largest number of error correction codewords per block.
+constexpr int QR_MAX_ECC_CODEWORDS = 30;
+
+/**
+ *  \brief  Computes the Reed-Solomon generator polynomials of all degrees up to the largest block.
+ *
+ *  Row n holds the coefficients of (x - 2^0)(x - 2^1)...(x - 2^(n-1)) from the highest to the
+ *  lowest power, without the leading 1.
+ */
+constexpr auto MakeRsGenerators()
+{
+    std::array<std::array<uint8_t, QR_MAX_ECC_CODEWORDS>, QR_MAX_ECC_CODEWORDS + 1> generators{};
+    for (int degree = 1; degree <= QR_MAX_ECC_CODEWORDS; ++degree)
+    {
+        auto& result = generators[degree];
+        result[degree - 1] = 1;
+        uint8_t root = 1;
+        for (int i = 0; i < degree; ++i)
+        {
+            for (int j = 0; j < degree; ++j)
+            {
+                result[j] = GfMultiply(result[j], root);
+                if (j + 1 < degree)
+                {
+                    result[j] ^= result[j + 1];
+                }
+            }
+            root = GfMultiply(root, 2);
+        }
+    }
+    return generators;
+}
+
+/// Reed-Solomon generator polynomials indexed by degree.
+constexpr auto QR_RS_GENERATORS = MakeRsGenerators();
+
+static_assert(QR_RS_GENERATORS[7][0] == 127 && QR_RS_GENERATORS[7][6] == 117, "Reed-Solomon generator mismatch");
+
+/**
+ *  \brief  Reed-Solomon encoder implementations.
+ */
+enum class RsKernel
+{
+    /// Logarithm table lookups, one coefficient at a time.
+    Scalar,
+    /// Nibble product tables applied to 16 coefficients at once with PSHUFB.
+    Ssse3,
+    /// Nibble product tables applied to all coefficients at once with VPSHUFB.
+    Avx2,
+};
+
+/**
+ *  \brief  Returns true if the CPU supports a kernel.
+ */
+bool IsRsKernelSupported(const RsKernel kernel);
+
+/**
+ *  \brief  Returns the fastest kernel the CPU supports.
+ */
+RsKernel GetBestRsKernel();
+
+/**
+ *  \brief  Returns the name of a kernel.
+ */
+const char* GetRsKernelName(const RsKernel kernel);
+
+/**
+ *  \brief  Layout of the Reed-Solomon blocks of a QR code.
+ *
+ *  The data codewords of the short blocks come first, the long blocks hold one data codeword more.
+ */
+struct RsBlockLayout
+{
+    int numShortBlocks = 1;
+    int numLongBlocks = 0;
+    /// Number of data codewords of a short block.
+    int shortDataLength = 0;
+    /// Number of error correction codewords per block, at most QR_MAX_ECC_CODEWORDS.
+    int eccLength = 0;
+};
+
+/**
+ *  \brief  Computes the error correction codewords of all blocks.
+ *
+ *  The vector kernels keep the remainder of a block in registers and multiply the generator by
+ *  the feedback codeword with two nibble table lookups per register; two blocks are encoded
+ *  interleaved to hide the latency of the feedback loop.
+ *
+ *  Throws std::invalid_argument if the CPU does not support the kernel.
+ *
+ *  \param  data    Data codewords of all blocks.
+ *  \param  layout  Block layout.
+ *  \param  ecc     Output of eccLength codewords per block, in block order.
+ *  \param  kernel  Implementation to use.
+ */
+void EncodeRsBlocks(const uint8_t* data, const RsBlockLayout& layout, uint8_t* ecc, const RsKernel kernel = GetBestRsKernel());
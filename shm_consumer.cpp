@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+#include <bc-ur/ur-decoder.hpp>
+
+#include "shm_ring.hpp"
+
+/**
+ *  \brief  Holds command line arguments.
+ */
+struct CommandLineArguments
+{
+    /// Name of the shared-memory frame ring.
+    std::string name = "/qurtest";
+    /// Detect and decode the QR code of every frame instead of taking the UR string from the slot.
+    bool decode = false;
+    /// Always skip to the newest frame, like a scanner that cannot keep up.
+    bool latest = false;
+    /// Maximum time to wait for the producer in milliseconds.
+    int timeoutMs = 10000;
+};
+
+/**
+ *  \brief  Parses command line arguments.
+ *  \param  argc    Number of command line arguments.
+ *  \param  argv    Array of command line strings.
+ *  \returns    Parsed command line arguments.
+ */
+static CommandLineArguments ParseCommandLineArguments(const int argc, char** argv)
+{
+    CommandLineArguments result;
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string(argv[i]);
+        if (arg == "--name")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.name = argv[++i];
+        }
+        else if (arg == "--decode")
+        {
+            result.decode = true;
+        }
+        else if (arg == "--latest")
+        {
+            result.latest = true;
+        }
+        else if (arg == "--timeout")
+        {
+            assert(i+1 < argc && "Value expected.");
+            result.timeoutMs = stoi(std::string(argv[++i]));
+        }
+        else if (arg == "-h")
+        {
+            std::cerr << "Usage: ./qurtest_consumer [OPTION]..." << std::endl;
+            std::cerr << "\t-h\tPrint help and exist." << std::endl;
+            std::cerr << "\t--name <value>\tName of the shared-memory frame ring (default=/qurtest)." << std::endl;
+            std::cerr << "\t--decode\tDetect and decode the QR code of every frame instead of taking the UR string from the ring." << std::endl;
+            std::cerr << "\t--latest\tAlways skip to the newest frame." << std::endl;
+            std::cerr << "\t--timeout <value>\tMaximum time to wait for the producer in milliseconds (default=10000)." << std::endl;
+            exit(0);
+        }
+        else
+        {
+            assert(false && "Unexpected command line argument");
+        }
+    }
+    return result;
+}
+
+/**
+ *  \brief  Consumes frames from the ring of a running qurtest until the message is recovered
+ *          or the producer finishes, and prints frame loss and latency.
+ */
+int main(int argc, char** argv)
+{
+    const auto args = ParseCommandLineArguments(argc, argv);
+    ShmRingReader reader(args.name, std::chrono::milliseconds(args.timeoutMs));
+    const auto& header = reader.Header();
+    std::cerr << "Ring: " << header.numSlots << " slots of " << header.width << "x" << header.height << " at " << header.fps << " fps" << std::endl;
+
+    cv::QRCodeDetector detector;
+    ur::URDecoder decoder;
+    std::vector<double> latencies;
+    size_t framesLost = 0;
+    size_t framesTorn = 0;
+    size_t framesToComplete = 0;
+    uint64_t next = 0;
+    while (!decoder.is_complete())
+    {
+        const uint64_t head = reader.Head();
+        if (next >= head)
+        {
+            if (reader.IsClosed() && next >= reader.Head())
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        // Frames older than the ring capacity have been overwritten.
+        const uint64_t oldest = args.latest ? head - 1 : (head > header.numSlots ? head - header.numSlots : 0);
+        if (next < oldest)
+        {
+            framesLost += oldest - next;
+            next = oldest;
+        }
+
+        ShmRingFrame frame;
+        if (!reader.Read(next, frame))
+        {
+            ++framesLost;
+            ++next;
+            continue;
+        }
+        std::string content;
+        if (args.decode)
+        {
+            cv::Mat points;
+            content = detector.detectAndDecode(frame.image, points);
+        }
+        else
+        {
+            content.assign(frame.ur, frame.urLength);
+        }
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        if (!reader.Validate(frame))
+        {
+            ++framesTorn;
+            ++next;
+            continue;
+        }
+
+        latencies.push_back(std::chrono::duration<double, std::milli>(now - std::chrono::nanoseconds(frame.displayTimeNs)).count());
+        if (!content.empty())
+        {
+            decoder.receive_part(content);
+        }
+        if (decoder.is_complete())
+        {
+            framesToComplete = latencies.size();
+        }
+        ++next;
+    }
+
+    std::cerr << "Frames received: " << latencies.size() << ", lost: " << framesLost << ", torn: " << framesTorn << std::endl;
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](const double p)
+        {
+            return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+        };
+        std::cerr << std::fixed << std::setprecision(3)
+            << "Latency [ms]: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max " << latencies.back()
+            << std::defaultfloat << std::endl;
+    }
+    if (decoder.is_complete())
+    {
+        std::cerr << "Message " << (decoder.is_success() ? "recovered" : "failed") << " after " << framesToComplete << " frames" << std::endl;
+    }
+    else
+    {
+        std::cerr << "Message not recovered" << std::endl;
+    }
+    return decoder.is_success() ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "shm_ring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ *  \brief  Rounds a size up to the ring alignment.
+ */
+static size_t AlignShmRingSize(const size_t size)
+{
+    return (size + SHM_RING_ALIGNMENT - 1) / SHM_RING_ALIGNMENT * SHM_RING_ALIGNMENT;
+}
+
+ShmRingWriter::ShmRingWriter(const std::string& name, const size_t numSlots, const size_t urCapacity, const double fps)
+    : m_name(name)
+    , m_numSlots(std::max<size_t>(1, numSlots))
+    , m_urCapacity(urCapacity)
+    , m_fps(fps)
+{
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    if (!m_header)
+    {
+        return;
+    }
+    m_header->state.store(static_cast<uint32_t>(ShmRingState::Closed), std::memory_order_release);
+    munmap(m_header, m_mappedSize);
+    shm_unlink(m_name.c_str());
+}
+
+void ShmRingWriter::Write(const Frame& frame, const std::chrono::steady_clock::time_point displayTime)
+{
+    if (!m_header)
+    {
+        Create(frame.image);
+    }
+    if (frame.image.cols != static_cast<int>(m_header->width) || frame.image.rows != static_cast<int>(m_header->height) || frame.image.type() != m_header->type)
+    {
+        throw std::invalid_argument("Frame size changed in a frame ring");
+    }
+    if (frame.ur.size() > m_urCapacity)
+    {
+        throw std::invalid_argument("UR string too long for a frame ring");
+    }
+
+    auto* slot = const_cast<ShmRingSlot*>(GetShmRingSlot(m_header, m_head));
+    auto* base = reinterpret_cast<uint8_t*>(slot);
+    slot->sequence.store(GetShmRingSequence(m_head) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->index = frame.index;
+    slot->displayTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(displayTime.time_since_epoch()).count();
+    slot->urLength = static_cast<uint32_t>(frame.ur.size());
+    std::memcpy(base + ShmRingSlot::UR_OFFSET, frame.ur.data(), frame.ur.size());
+    cv::Mat image(frame.image.size(), frame.image.type(), base + m_header->imageOffset, m_header->imageStride);
+    frame.image.copyTo(image);
+
+    slot->sequence.store(GetShmRingSequence(m_head), std::memory_order_release);
+    m_header->head.store(++m_head, std::memory_order_release);
+}
+
+void ShmRingWriter::Create(const cv::Mat& image)
+{
+    const size_t imageStride = image.cols * image.elemSize();
+    const size_t imageOffset = AlignShmRingSize(ShmRingSlot::UR_OFFSET + m_urCapacity);
+    const size_t slotStride = AlignShmRingSize(imageOffset + image.rows * imageStride);
+    const size_t size = sizeof(ShmRingHeader) + m_numSlots * slotStride;
+
+    // A ring left behind by a crashed producer is replaced.
+    shm_unlink(m_name.c_str());
+    const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Cannot create shared memory " + m_name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        shm_unlink(m_name.c_str());
+        throw std::system_error(error, std::generic_category(), "Cannot resize shared memory " + m_name);
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        const int error = errno;
+        shm_unlink(m_name.c_str());
+        throw std::system_error(error, std::generic_category(), "Cannot map shared memory " + m_name);
+    }
+
+    // The object is zero filled, so all slot sequences start at 0 and no frame appears written.
+    m_header = new (memory) ShmRingHeader();
+    m_mappedSize = size;
+    std::memcpy(m_header->magic, SHM_RING_MAGIC, sizeof(m_header->magic));
+    m_header->version = SHM_RING_VERSION;
+    m_header->numSlots = static_cast<uint32_t>(m_numSlots);
+    m_header->slotStride = slotStride;
+    m_header->imageOffset = imageOffset;
+    m_header->urCapacity = static_cast<uint32_t>(m_urCapacity);
+    m_header->width = static_cast<uint32_t>(image.cols);
+    m_header->height = static_cast<uint32_t>(image.rows);
+    m_header->type = image.type();
+    m_header->imageStride = imageStride;
+    m_header->fps = m_fps;
+    m_header->head.store(0, std::memory_order_relaxed);
+    m_header->state.store(static_cast<uint32_t>(ShmRingState::Open), std::memory_order_release);
+}
+
+ShmRingReader::ShmRingReader(const std::string& name, const std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    int fd = -1;
+    struct stat status{};
+    // The producer creates the object with the first frame and sizes it right after.
+    for (;;)
+    {
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd >= 0 && fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(ShmRingHeader))
+        {
+            break;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        else if (errno != ENOENT)
+        {
+            throw std::system_error(errno, std::generic_category(), "Cannot open shared memory " + name);
+        }
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            throw std::runtime_error("Shared memory " + name + " does not exist");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    m_mappedSize = static_cast<size_t>(status.st_size);
+    void* memory = mmap(nullptr, m_mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(), "Cannot map shared memory " + name);
+    }
+    m_header = static_cast<const ShmRingHeader*>(memory);
+
+    while (m_header->state.load(std::memory_order_acquire) == static_cast<uint32_t>(ShmRingState::Initializing))
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            throw std::runtime_error("Shared memory " + name + " is not initialized");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (std::memcmp(m_header->magic, SHM_RING_MAGIC, sizeof(m_header->magic)) != 0 || m_header->version != SHM_RING_VERSION
+        || sizeof(ShmRingHeader) + m_header->numSlots * m_header->slotStride > m_mappedSize)
+    {
+        throw std::runtime_error("Shared memory " + name + " is not a frame ring");
+    }
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    if (m_header)
+    {
+        munmap(const_cast<ShmRingHeader*>(m_header), m_mappedSize);
+    }
+}
+
+const ShmRingHeader& ShmRingReader::Header() const
+{
+    return *m_header;
+}
+
+uint64_t ShmRingReader::Head() const
+{
+    return m_header->head.load(std::memory_order_acquire);
+}
+
+bool ShmRingReader::IsClosed() const
+{
+    return m_header->state.load(std::memory_order_acquire) == static_cast<uint32_t>(ShmRingState::Closed);
+}
+
+bool ShmRingReader::Read(const uint64_t n, ShmRingFrame& frame) const
+{
+    const auto* slot = GetShmRingSlot(m_header, n);
+    if (slot->sequence.load(std::memory_order_acquire) != GetShmRingSequence(n))
+    {
+        return false;
+    }
+    const auto* base = reinterpret_cast<const uint8_t*>(slot);
+    frame.n = n;
+    frame.index = slot->index;
+    frame.displayTimeNs = slot->displayTimeNs;
+    frame.ur = reinterpret_cast<const char*>(base + ShmRingSlot::UR_OFFSET);
+    frame.urLength = std::min<size_t>(slot->urLength, m_header->urCapacity);
+    frame.image = cv::Mat(m_header->height, m_header->width, m_header->type, const_cast<uint8_t*>(base + m_header->imageOffset), m_header->imageStride);
+    return true;
+}
+
+bool ShmRingReader::Validate(const ShmRingFrame& frame) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return GetShmRingSequence(frame.n) == GetShmRingSlot(m_header, frame.n)->sequence.load(std::memory_order_relaxed);
+}
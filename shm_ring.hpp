@@ -0,0 +1,267 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+#include "frame_stream.hpp"
+
+/**
+ *  \file
+ *  Shared-memory ring of frames for scanner processes on the same host.
+ *
+ *  The POSIX shared-memory object consists of a ShmRingHeader followed by numSlots slots of
+ *  slotStride bytes. A slot starts with a ShmRingSlot, followed by the UR string at
+ *  ShmRingSlot::UR_OFFSET and the image at imageOffset. All offsets are multiples of 64 bytes.
+ *
+ *  Frame n of the stream is written into slot n % numSlots. Each slot is guarded by a sequence
+ *  lock: its sequence is 2n + 1 while frame n is written and 2n + 2 once it is complete, and the
+ *  head is n + 1 after that. The single producer never waits for consumers, so a consumer that
+ *  falls behind by numSlots frames loses frames. Consumers read a slot in place and validate
+ *  afterwards that its sequence has not changed; any number of consumers can read concurrently.
+ *
+ *  The producer creates, sizes and maps the object with its first frame, fills in the header and
+ *  then sets the state from Initializing to Open. Consumers may start first: they wait until the
+ *  object exists, has at least the header size and has left the Initializing state.
+ */
+
+/// Magic bytes at the start of a frame ring.
+constexpr char SHM_RING_MAGIC[8] = {'Q', 'U', 'R', 'R', 'I', 'N', 'G', 'S'};
+/// Version of the frame ring layout.
+constexpr uint32_t SHM_RING_VERSION = 1;
+/// Alignment of the slots and their parts, a cache line.
+constexpr size_t SHM_RING_ALIGNMENT = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory atomics must be lock free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared-memory atomics must be lock free");
+
+/**
+ *  \brief  States of a frame ring.
+ */
+enum class ShmRingState : uint32_t
+{
+    /// The producer is still initializing the header.
+    Initializing,
+    /// Frames are being published.
+    Open,
+    /// The producer has finished; no frames follow the head.
+    Closed,
+};
+
+/**
+ *  \brief  Header of a frame ring. It is written once by the producer before the state is Open.
+ */
+struct alignas(SHM_RING_ALIGNMENT) ShmRingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numSlots;
+    /// Size of a slot in bytes.
+    uint64_t slotStride;
+    /// Offset of the image from the start of a slot.
+    uint64_t imageOffset;
+    /// Maximum length of a UR string.
+    uint32_t urCapacity;
+    /// Image width in pixels.
+    uint32_t width;
+    /// Image height in pixels.
+    uint32_t height;
+    /// OpenCV type of the image, e.g. CV_8UC3.
+    int32_t type;
+    /// Row stride of the image in bytes.
+    uint64_t imageStride;
+    /// Number of frames per second the producer aims at.
+    double fps;
+    /// ShmRingState of the ring.
+    alignas(SHM_RING_ALIGNMENT) std::atomic<uint32_t> state;
+    /// Number of completely written frames.
+    alignas(SHM_RING_ALIGNMENT) std::atomic<uint64_t> head;
+};
+
+/**
+ *  \brief  Header of a slot.
+ */
+struct alignas(SHM_RING_ALIGNMENT) ShmRingSlot
+{
+    /// Offset of the UR string from the start of a slot.
+    static constexpr size_t UR_OFFSET = SHM_RING_ALIGNMENT;
+
+    /// Sequence lock, odd while the slot is written.
+    std::atomic<uint64_t> sequence;
+    /// Position of the frame in the stream.
+    uint64_t index;
+    /// Time at which the frame was published, std::chrono::steady_clock (CLOCK_MONOTONIC) in nanoseconds.
+    int64_t displayTimeNs;
+    /// Length of the UR string.
+    uint32_t urLength;
+};
+
+static_assert(sizeof(ShmRingSlot) <= ShmRingSlot::UR_OFFSET, "Unexpected slot layout");
+
+/**
+ *  \brief  Returns the slot sequence of frame n once it is complete.
+ */
+inline uint64_t GetShmRingSequence(const uint64_t n)
+{
+    return 2 * n + 2;
+}
+
+/**
+ *  \brief  Returns a slot of a mapped frame ring.
+ */
+inline const ShmRingSlot* GetShmRingSlot(const ShmRingHeader* header, const uint64_t n)
+{
+    const auto* base = reinterpret_cast<const uint8_t*>(header) + sizeof(ShmRingHeader);
+    return reinterpret_cast<const ShmRingSlot*>(base + (n % header->numSlots) * header->slotStride);
+}
+
+/**
+ *  \brief  Publishes frames into a POSIX shared-memory frame ring.
+ *
+ *  The ring is created with the first frame, whose size and type determine the slot layout, and
+ *  removed by the destructor. Publishing copies the frame into its slot and never waits for
+ *  consumers or allocates.
+ */
+class ShmRingWriter
+{
+public:
+    /**
+     *  \brief  Creates a writer.
+     *  \param  name    Name of the shared-memory object, e.g. "/qurtest".
+     *  \param  numSlots    Number of slots.
+     *  \param  urCapacity  Maximum length of a UR string.
+     *  \param  fps Number of frames per second stored in the header.
+     */
+    ShmRingWriter(const std::string& name, const size_t numSlots, const size_t urCapacity, const double fps);
+
+    /**
+     *  \brief  Closes the ring and removes the shared-memory object.
+     *
+     *  Consumers that have mapped it can still read the frames.
+     */
+    ~ShmRingWriter();
+
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    /**
+     *  \brief  Publishes a frame.
+     *
+     *  Throws std::invalid_argument if the frame does not fit the slots and std::system_error if
+     *  the ring cannot be created.
+     *
+     *  \param  frame   Frame to publish.
+     *  \param  displayTime Time at which the frame is shown.
+     */
+    void Write(const Frame& frame, const std::chrono::steady_clock::time_point displayTime);
+
+private:
+    void Create(const cv::Mat& image);
+
+    const std::string m_name;
+    const size_t m_numSlots;
+    const size_t m_urCapacity;
+    const double m_fps;
+    ShmRingHeader* m_header = nullptr;
+    size_t m_mappedSize = 0;
+    uint64_t m_head = 0;
+};
+
+/**
+ *  \brief  A frame read in place from a frame ring.
+ */
+struct ShmRingFrame
+{
+    /// Position of the frame in the stream.
+    uint64_t n = 0;
+    /// Index stored by the producer.
+    uint64_t index = 0;
+    /// Publication time, std::chrono::steady_clock in nanoseconds.
+    int64_t displayTimeNs = 0;
+    /// UR string. It points into the ring.
+    const char* ur = nullptr;
+    /// Length of the UR string.
+    size_t urLength = 0;
+    /// Image. It points into the ring and must not be modified.
+    cv::Mat image;
+};
+
+/**
+ *  \brief  Maps a frame ring of another process for reading.
+ */
+class ShmRingReader
+{
+public:
+    /**
+     *  \brief  Opens a frame ring, waiting until its producer has created it.
+     *
+     *  Throws std::system_error on mapping errors and std::runtime_error on layout mismatches or
+     *  when the ring does not appear within the timeout.
+     *
+     *  \param  name    Name of the shared-memory object.
+     *  \param  timeout Maximum waiting time.
+     */
+    ShmRingReader(const std::string& name, const std::chrono::milliseconds timeout);
+
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    /**
+     *  \brief  Returns the header of the ring.
+     */
+    const ShmRingHeader& Header() const;
+
+    /**
+     *  \brief  Returns the number of completely written frames.
+     */
+    uint64_t Head() const;
+
+    /**
+     *  \brief  Returns true once the producer has finished.
+     */
+    bool IsClosed() const;
+
+    /**
+     *  \brief  Starts reading frame n in place.
+     *
+     *  \param  n   Position of the frame in the stream.
+     *  \param  frame   Views of the frame in the ring.
+     *  \returns    False if the frame is not written yet or has been overwritten.
+     */
+    bool Read(const uint64_t n, ShmRingFrame& frame) const;
+
+    /**
+     *  \brief  Returns true if a frame returned by Read was not overwritten since.
+     *
+     *  Everything read from the frame before this call is valid if it returns true.
+     */
+    bool Validate(const ShmRingFrame& frame) const;
+
+private:
+    const ShmRingHeader* m_header = nullptr;
+    size_t m_mappedSize = 0;
+};
@@ -0,0 +1,297 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+
+#include <bc-ur/ur-decoder.hpp>
+
+#include "qr_capacity.hpp"
+#include "qr_encoder.hpp"
+#include "qur.hpp"
+
+namespace
+{
+
+/**
+ *  \brief  A point of the parameter grid.
+ */
+struct SweepConfig
+{
+    size_t messageLength;
+    size_t fragmentLength;
+    int qrSize;
+    QRecLevel ecLevel;
+    double fps;
+    std::string maskPolicy;
+};
+
+/**
+ *  \brief  Outcome of a single transfer.
+ */
+struct TrialResult
+{
+    int qrVersion = 0;
+    size_t cycleLength = 0;
+    size_t framesRendered = 0;
+    std::chrono::nanoseconds renderTime{0};
+    bool isSuccess = false;
+    size_t framesToComplete = 0;
+};
+
+/**
+ *  \brief  Returns the QR version of the longest UR string of a configuration, or 0 if it does not fit.
+ */
+int GetRequiredQrVersion(const SweepConfig& config, const SweepOptions& options)
+{
+    const size_t cborLength = GetMessageUrCborLength(config.messageLength);
+    size_t urLength = GetSinglePartUrLength(cborLength);
+    if (!options.stream.isSinglePart)
+    {
+        if (config.fragmentLength > config.messageLength || config.fragmentLength < UR_MIN_FRAGMENT_LENGTH || cborLength < UR_MIN_FRAGMENT_LENGTH)
+        {
+            return 0;
+        }
+        // Fountain parts keep counting up for all loops, repeated sequences restart.
+        const size_t cycleLength = GetMultiPartSeqLength(cborLength, config.fragmentLength) + options.stream.numExtraParts;
+        const size_t maxSeqNum = options.stream.isFountain ? options.numLoops * cycleLength : cycleLength;
+        urLength = GetMultiPartUrLength(cborLength, config.fragmentLength, maxSeqNum);
+    }
+
+    const auto mode = GetQrencodeMode(options.stream.qr.mode);
+    const int minVersion = options.stream.qr.version > 0 ? options.stream.qr.version : QR_MIN_VERSION;
+    const int maxVersion = options.stream.qr.version > 0 ? options.stream.qr.version : QR_MAX_VERSION;
+    for (int version = minVersion; version <= maxVersion; ++version)
+    {
+        if (static_cast<size_t>(GetQrCapacity(version, config.ecLevel, mode)) >= urLength)
+        {
+            return version;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  \brief  Returns true if the UR strings of a configuration fit a QR code that fits the QR size.
+ */
+bool IsFitting(const SweepConfig& config, const SweepOptions& options)
+{
+    const int version = GetRequiredQrVersion(config, options);
+    return version > 0 && config.qrSize >= GetQrWidth(version);
+}
+
+TrialResult RunTrial(const SweepConfig& config, const SweepOptions& options, const size_t trial)
+{
+    TrialResult result;
+    const auto message = MakeMessageUr(config.messageLength, static_cast<uint32_t>(options.seed + trial));
+
+    auto streamOptions = options.stream;
+    streamOptions.maxFragmentLength = config.fragmentLength;
+    streamOptions.qrSize = config.qrSize;
+    streamOptions.qr.ecLevel = config.ecLevel;
+    if (!options.maskPolicies.empty())
+    {
+        streamOptions.qr.backend = QrEncoderBackend::InTree;
+        ParseQrMaskPolicy(config.maskPolicy, streamOptions.qr);
+    }
+
+    UrSource urs(message, streamOptions);
+    result.cycleLength = urs.CycleLength();
+    const size_t numFrames = options.numLoops * result.cycleLength;
+    const auto lifeHashImage = CreateLifeHashImage(message, streamOptions.lifeHashImageSize);
+
+    FrameSource source = [&](Frame& frame)
+    {
+        if (result.framesRendered == numFrames)
+        {
+            return false;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        frame.index = result.framesRendered++;
+        frame.ur = urs.Next();
+        result.qrVersion = std::max(result.qrVersion, RenderFrame(lifeHashImage, streamOptions, frame));
+        result.renderTime += std::chrono::steady_clock::now() - start;
+        return true;
+    };
+    std::unique_ptr<CameraSimulator> camera;
+    if (options.simulateCamera)
+    {
+        camera = std::make_unique<CameraSimulator>(source, result.cycleLength, config.fps, options.camera);
+    }
+
+    cv::QRCodeDetector detector;
+    ur::URDecoder decoder;
+    Frame frame;
+    size_t framesProcessed = 0;
+    while (!decoder.is_complete() && (camera ? camera->Next(frame) : source(frame)))
+    {
+        ++framesProcessed;
+        cv::Mat points;
+        const auto content = detector.detectAndDecode(frame.image, points);
+        if (!content.empty())
+        {
+            decoder.receive_part(content);
+        }
+    }
+    result.isSuccess = decoder.is_complete() && decoder.is_success() && decoder.result_ur().cbor() == message.cbor();
+    result.framesToComplete = result.isSuccess ? framesProcessed : 0;
+    return result;
+}
+
+const char* GetEcLevelName(const QRecLevel level)
+{
+    static const char* const NAMES[] = {"L", "M", "Q", "H"};
+    return NAMES[level - QR_ECLEVEL_L];
+}
+
+}
+
+std::vector<double> ParseSweepRange(const std::string& spec)
+{
+    std::vector<double> result;
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        std::vector<double> bounds;
+        std::istringstream parts(item);
+        std::string part;
+        while (std::getline(parts, part, ':'))
+        {
+            bounds.push_back(std::stod(part));
+        }
+        if (bounds.size() == 1)
+        {
+            result.push_back(bounds[0]);
+        }
+        else if (bounds.size() == 3 && bounds[2] > 0)
+        {
+            // Tolerate rounding of fractional steps at the inclusive end.
+            for (size_t i = 0; bounds[0] + i * bounds[2] <= bounds[1] + bounds[2] * 1e-9; ++i)
+            {
+                result.push_back(bounds[0] + i * bounds[2]);
+            }
+        }
+        else
+        {
+            throw std::invalid_argument("Invalid sweep range " + item);
+        }
+    }
+    if (result.empty())
+    {
+        throw std::invalid_argument("Empty sweep range " + spec);
+    }
+    return result;
+}
+
+void RunSweep(const SweepOptions& options, std::ostream& os)
+{
+    const auto maskPolicies = options.maskPolicies.empty() ? std::vector<std::string>{GetQrMaskPolicyName(options.stream.qr)} : options.maskPolicies;
+    std::vector<SweepConfig> configs;
+    size_t numSkipped = 0;
+    for (const auto messageLength : options.messageLengths)
+    {
+        // The fragment length does not apply to single part URs, one row per other parameter suffices.
+        for (const auto fragmentLength : options.stream.isSinglePart ? std::vector<size_t>{options.fragmentLengths.front()} : options.fragmentLengths)
+        {
+            for (const auto qrSize : options.qrSizes)
+            {
+                for (const auto ecLevel : options.ecLevels)
+                {
+                    for (const auto fps : options.fpss)
+                    {
+                        for (const auto& maskPolicy : maskPolicies)
+                        {
+                            const SweepConfig config{messageLength, fragmentLength, qrSize, ecLevel, fps, maskPolicy};
+                            if (IsFitting(config, options))
+                            {
+                                configs.push_back(config);
+                            }
+                            else
+                            {
+                                ++numSkipped;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::cerr << "Sweep: " << configs.size() << " configurations, " << numSkipped << " skipped" << std::endl;
+
+    // Transfers are independent, so they are spread over the cores individually instead of per configuration.
+    std::vector<TrialResult> results(configs.size() * options.numTrials);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(results.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            results[i] = RunTrial(configs[i / options.numTrials], options, i % options.numTrials);
+        }
+    }, static_cast<double>(results.size()));
+
+    os << "message_length,fragment_length,qr_size,ec_level,fps,mask_policy,qr_version,module_px,cycle_frames,frames_rendered,encode_ms_per_frame,decode_success_rate,frames_to_complete,seconds_to_complete\n";
+    for (size_t c = 0; c < configs.size(); ++c)
+    {
+        const auto& config = configs[c];
+        int qrVersion = 0;
+        size_t framesRendered = 0;
+        size_t numSuccesses = 0;
+        size_t framesToComplete = 0;
+        std::chrono::nanoseconds renderTime{0};
+        for (size_t t = 0; t < options.numTrials; ++t)
+        {
+            const auto& result = results[c * options.numTrials + t];
+            qrVersion = std::max(qrVersion, result.qrVersion);
+            framesRendered += result.framesRendered;
+            renderTime += result.renderTime;
+            numSuccesses += result.isSuccess;
+            framesToComplete += result.framesToComplete;
+        }
+        const auto& first = results[c * options.numTrials];
+
+        os << config.messageLength << ',' << (options.stream.isSinglePart ? 0 : config.fragmentLength) << ',' << config.qrSize
+            << ',' << GetEcLevelName(config.ecLevel) << ',' << config.fps << ',' << config.maskPolicy
+            << ',' << qrVersion << ',' << config.qrSize / GetQrWidth(qrVersion)
+            << ',' << first.cycleLength
+            << ',' << static_cast<double>(framesRendered) / options.numTrials
+            << ',' << std::chrono::duration<double, std::milli>(renderTime).count() / std::max<size_t>(1, framesRendered)
+            << ',' << static_cast<double>(numSuccesses) / options.numTrials << ',';
+        if (numSuccesses > 0)
+        {
+            const double frames = static_cast<double>(framesToComplete) / numSuccesses;
+            os << frames << ',' << frames / (options.simulateCamera ? options.camera.fps : config.fps);
+        }
+        else
+        {
+            os << ',';
+        }
+        os << '\n';
+    }
+}
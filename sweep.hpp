@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <qrencode.h>
+
+#include "camera_sim.hpp"
+#include "frame_stream.hpp"
+
+/**
+ *  \brief  Parameter ranges of a sweep and the settings shared by all configurations.
+ */
+struct SweepOptions
+{
+    /// Message lengths in bytes.
+    std::vector<size_t> messageLengths;
+    /// Maximum fragment lengths in bytes. Ignored for single part UR.
+    std::vector<size_t> fragmentLengths;
+    /// QR image sizes in pixels.
+    std::vector<int> qrSizes;
+    /// QR error correction levels.
+    std::vector<QRecLevel> ecLevels;
+    /// Display frame rates.
+    std::vector<double> fpss;
+    /// Mask policies as accepted by ParseQrMaskPolicy. When given, all configurations use the
+    /// in-tree QR encoder, otherwise the encoder and mask policy of stream.
+    std::vector<std::string> maskPolicies;
+    /// Settings shared by all configurations. Fragment length, QR size, EC level and mask policy are overridden.
+    FrameStreamOptions stream;
+    /// Film the displayed frames with a simulated camera.
+    bool simulateCamera = false;
+    /// Parameters of the simulated camera.
+    CameraOptions camera;
+    /// Number of transfers per configuration. Transfer i uses the message of seed + i.
+    size_t numTrials = 1;
+    /// Seed of the first transfer.
+    uint32_t seed = 0;
+    /// Number of repetitions of the UR sequence before a transfer fails.
+    size_t numLoops = 1;
+};
+
+/**
+ *  \brief  Parses a sweep range.
+ *
+ *  The range is a comma separated list of values and inclusive start:stop:step ranges, e.g.
+ *  "100:1000:100,2000". Throws std::invalid_argument on malformed ranges.
+ *
+ *  \param  spec    Range specification.
+ *  \returns    Values in the order of the specification.
+ */
+std::vector<double> ParseSweepRange(const std::string& spec);
+
+/**
+ *  \brief  Runs every configuration of a sweep and writes one CSV row per configuration.
+ *
+ *  Every transfer renders the UR sequence, optionally films it with the simulated camera and
+ *  decodes the frames with cv::QRCodeDetector until the UR decoder completes or the sequence has
+ *  been shown numLoops times. Transfers of all configurations run in parallel. Configurations
+ *  whose UR strings do not fit a QR code, or whose QR code has more modules than the QR size has
+ *  pixels, are skipped. With single part URs the fragment lengths are ignored.
+ *
+ *  \param  options Sweep settings.
+ *  \param  os  Output stream of the CSV.
+ */
+void RunSweep(const SweepOptions& options, std::ostream& os);
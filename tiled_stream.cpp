@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tiled_stream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+#include "pipeline_stats.hpp"
+
+TiledStream::TiledStream(const std::vector<ur::UR>& messages, const TiledStreamOptions& options)
+    : m_options(options)
+{
+    const int numTiles = static_cast<int>(messages.size());
+    const int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(numTiles))));
+    const int rows = (numTiles + cols - 1) / cols;
+
+    for (int i = 0; i < numTiles; ++i)
+    {
+        Tile tile;
+        tile.options = m_options.stream;
+        // Degradations apply to the whole canvas, not to each tile.
+        tile.options.degradation = DegradationOptions();
+        if (!m_options.fragmentLengths.empty())
+        {
+            tile.options.maxFragmentLength = m_options.fragmentLengths[i % m_options.fragmentLengths.size()];
+        }
+        tile.urs = std::make_unique<UrSource>(messages[i], tile.options);
+        if (!m_options.phases.empty())
+        {
+            for (size_t p = m_options.phases[i % m_options.phases.size()]; p > 0; --p)
+            {
+                tile.urs->Next();
+            }
+        }
+        {
+            StageTimer timer(Stage::LifeHash);
+            tile.lifeHashImage = CreateLifeHashImage(messages[i], tile.options.lifeHashImageSize);
+        }
+        const auto tileSize = GetFrameSize(tile.lifeHashImage, tile.options.qrSize);
+        tile.roi = cv::Rect((i % cols) * tileSize.width, (i / cols) * tileSize.height, tileSize.width, tileSize.height);
+        m_canvasSize = cv::Size(cols * tileSize.width, rows * tileSize.height);
+        m_cycleLength = std::max(m_cycleLength, tile.urs->CycleLength());
+        m_tiles.push_back(std::move(tile));
+    }
+    for (int i = numTiles; i < rows * cols; ++i)
+    {
+        const auto& roi = m_tiles.front().roi;
+        m_emptyRois.emplace_back((i % cols) * roi.width, (i / cols) * roi.height, roi.width, roi.height);
+    }
+    m_tileFrames.resize(m_tiles.size());
+    m_canvases = std::make_unique<ImagePool>(m_canvasSize, CV_8UC3);
+}
+
+size_t TiledStream::CycleLength() const
+{
+    return m_cycleLength;
+}
+
+bool TiledStream::Next(Frame& frame)
+{
+    if (m_options.numLoops > 0 && m_index == m_options.numLoops * m_cycleLength)
+    {
+        return false;
+    }
+    frame.index = m_index++;
+
+    auto& tiles = m_tileFrames;
+    {
+        StageTimer timer(Stage::UrEncoding);
+        for (size_t i = 0; i < m_tiles.size(); ++i)
+        {
+            tiles[i].index = frame.index;
+            tiles[i].ur = m_tiles[i].urs->Next();
+        }
+    }
+
+    m_canvases->Acquire(frame);
+    const auto& canvas = frame.image;
+    for (const auto& roi : m_emptyRois)
+    {
+        canvas(roi).setTo(cv::Scalar::all(255));
+    }
+    std::vector<std::exception_ptr> errors(m_tiles.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(m_tiles.size())), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            // The tile is a view of the canvas of the frame size, so the frame is rendered in place.
+            tiles[i].image = canvas(m_tiles[i].roi);
+            try
+            {
+                RenderFrame(m_tiles[i].lifeHashImage, m_tiles[i].options, tiles[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+    for (auto& tile : tiles)
+    {
+        tile.image.release();
+    }
+    for (const auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (m_options.stream.degradation.IsEnabled())
+    {
+        StageTimer timer(Stage::Degradation);
+        DegradeFrame(frame.image, m_options.stream.degradation, frame.index);
+    }
+    RecordFrameRendered();
+
+    frame.ur.clear();
+    for (const auto& tile : tiles)
+    {
+        frame.ur += (frame.ur.empty() ? "" : " ") + tile.ur;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2021 Pavel Najman
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ *  and associated documentation files (the "Software"), to dea in the Software without
+ *  restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all copies or
+ *  substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ *  BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ *  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <bc-ur/bc-ur.hpp>
+
+#include "frame_stream.hpp"
+
+/**
+ *  \brief  Settings of a TiledStream.
+ */
+struct TiledStreamOptions
+{
+    /// Settings shared by all streams. The fragment length is the default of the streams without their own.
+    FrameStreamOptions stream;
+    /// Maximum fragment length of each stream, repeated cyclically if shorter than the number of streams.
+    std::vector<size_t> fragmentLengths;
+    /// Number of parts each stream skips at the start, repeated cyclically if shorter than the number of streams.
+    std::vector<size_t> phases;
+    /// Number of repetitions of the longest UR sequence; unlimited when 0.
+    size_t numLoops = 0;
+};
+
+/**
+ *  \brief  Renders several independent UR sequences tiled into one canvas per frame.
+ *
+ *  Each message has its own UR source and lifehash image. The tiles of a frame are rendered in
+ *  parallel directly into a canvas, and the streams are laid out in a grid of at most as many rows
+ *  as columns: with ceil(sqrt(n)) columns, stream i takes column i % cols and row i / cols, and
+ *  every cell has the frame size of a single stream. Degradations apply to the whole canvas. Canvases are taken from an ImagePool and return to it when the frames showing them
+ *  are released, so rendering does not allocate in the steady state. Frames are rendered on demand in
+ *  Next(); the UR string of a frame lists the strings of its tiles separated by spaces.
+ */
+class TiledStream
+{
+public:
+    /**
+     *  \brief  Creates a stream of tiled frames.
+     *  \param  messages    Messages of the tiles.
+     *  \param  options Stream settings.
+     */
+    TiledStream(const std::vector<ur::UR>& messages, const TiledStreamOptions& options);
+
+    /**
+     *  \brief  Returns the number of frames before the longest UR sequence repeats.
+     */
+    size_t CycleLength() const;
+
+    /**
+     *  \brief  Renders the next frame.
+     *  \param  frame   The next frame. Its previous image is replaced by a canvas from the pool.
+     *  \returns    False if the stream has ended.
+     */
+    bool Next(Frame& frame);
+
+private:
+    /**
+     *  \brief  A UR sequence shown in one tile.
+     */
+    struct Tile
+    {
+        FrameStreamOptions options;
+        std::unique_ptr<UrSource> urs;
+        cv::Mat lifeHashImage;
+        cv::Rect roi;
+    };
+
+    const TiledStreamOptions m_options;
+    std::vector<Tile> m_tiles;
+    std::vector<Frame> m_tileFrames;
+    /// Grid cells without a tile, cleared in every frame because pooled canvases keep old contents.
+    std::vector<cv::Rect> m_emptyRois;
+    cv::Size m_canvasSize;
+    std::unique_ptr<ImagePool> m_canvases;
+    size_t m_cycleLength = 0;
+    size_t m_index = 0;
+};